@@ -15,10 +15,12 @@
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QMetaType>
 #include <QtCore/QMimeData>
+#include <QtCore/QPointer>
 #include <QtCore/QProcessEnvironment>
 #include <QtCore/QRegularExpression>
 #include <QtCore/QSettings>
 #include <QtCore/QStandardPaths>
+#include <QtCore/QtEndian>
 #include <QtCore/QThread>
 #include <QtCore/QTimer>
 
@@ -241,20 +243,189 @@ QVariant PythonValueVariantToQVariant(const PythonValueVariant &value_variant)
     return QVariant();
 }
 
+/*
+ Convert a Python object to a QVariant in a single pass, without an intermediate PythonValueVariant.
+
+ The conversion matches PythonValueVariantToQVariant(PyObjectToValueVariant(py_object)), except that capsules
+ convert to the wrapped QObject and dict items with keys that are not strings are skipped. The GIL must be held.
+ */
 QVariant PyObjectToQVariant(PyObject *py_object)
 {
-    return PythonValueVariantToQVariant(PyObjectToValueVariant(py_object));
+    PythonSupport *python_support = PythonSupport::instance();
+
+    switch (python_support->valueKind(py_object))
+    {
+        case PythonSupport::ValueNone:
+            return QVariant();
+
+        case PythonSupport::ValueString:
+        {
+            Py_ssize_t size = 0;
+            const char *s = python_support->stringValue(py_object, size);
+            return s ? QString::fromUtf8(s, size) : QString();
+        }
+
+        case PythonSupport::ValueInt:
+            return QVariant(static_cast<int>(python_support->intValue(py_object)));
+
+        case PythonSupport::ValueFloat:
+            return QVariant(python_support->floatValue(py_object));
+
+        case PythonSupport::ValueCapsule:
+            return QVariant::fromValue(static_cast<QObject *>(python_support->capsuleValue(py_object)));
+
+        case PythonSupport::ValueDict:
+        {
+            QVariantMap map;
+            Py_ssize_t pos = 0;
+            PyObject *py_key = NULL;
+            PyObject *py_value = NULL;
+            while (python_support->dictNext(py_object, pos, py_key, py_value))
+            {
+                Py_ssize_t size = 0;
+                const char *key = python_support->stringValue(py_key, size);
+                if (key)
+                    map.insert(QString::fromUtf8(key, size), PyObjectToQVariant(py_value));
+            }
+            return map;
+        }
+
+        case PythonSupport::ValueSequence:
+        {
+            Py_ssize_t count = 0;
+            PyObject **items = python_support->sequenceItems(py_object, count);
+            QVariantList list;
+            list.reserve(count);
+            for (Py_ssize_t i = 0; i < count; ++i)
+                list.append(PyObjectToQVariant(items[i]));
+            return list;
+        }
+
+        default:
+            return QVariant::fromValue(PyObjectPtr(py_object, true));
+    }
+}
+
+static PyObject *QStringToPyObject(const QString &str)
+{
+    QByteArray utf8 = str.toUtf8();
+    return PythonSupport::instance()->newString(utf8.constData(), utf8.size());
 }
 
 inline PyObject *WrapQObject(QObject *ptr)
 {
-    return PythonValueVariantToPyObject(QVariantToPythonValueVariant(QVariant::fromValue(static_cast<QObject *>(ptr))));
+    return PythonSupport::instance()->newCapsule(ptr);
 }
 
-// New reference
+/*
+ Convert a QVariant to a Python object in a single pass, without an intermediate PythonValueVariant.
+
+ The conversion matches PythonValueVariantToPyObject(QVariantToPythonValueVariant(value)); lists convert to tuples.
+ Returns a new reference. The GIL must be held.
+ */
 PyObject *QVariantToPyObject(const QVariant &value)
 {
-    return PythonValueVariantToPyObject(QVariantToPythonValueVariant(value));
+    PythonSupport *python_support = PythonSupport::instance();
+
+    const void *data = value.constData();
+    int type = value.userType();
+
+    switch (type)
+    {
+        case QMetaType::Char:
+            return python_support->newInt(static_cast<long>(*((char*)data)));
+
+        case QMetaType::UChar:
+            return python_support->newInt(static_cast<long>(*((unsigned char*)data)));
+
+        case QMetaType::Short:
+            return python_support->newInt(static_cast<long>(*((short*)data)));
+
+        case QMetaType::UShort:
+            return python_support->newInt(static_cast<long>(*((unsigned short*)data)));
+
+        case QMetaType::Long:
+            return python_support->newInt(*((long*)data));
+
+        case QMetaType::ULong:
+            return python_support->newLongLong(static_cast<long long>(*((unsigned long*)data)));
+
+        case QMetaType::Bool:
+            return python_support->newBool(value.toBool());
+
+        case QMetaType::Int:
+            return python_support->newInt(static_cast<long>(*((int*)data)));
+
+        case QMetaType::UInt:
+            return python_support->newLongLong(static_cast<long long>(*((unsigned int*)data)));
+
+        case QMetaType::QChar:
+            return python_support->newInt(static_cast<long>(*((short*)data)));
+
+        case QMetaType::Float:
+            return python_support->newFloat(static_cast<double>(*((float*)data)));
+
+        case QMetaType::Double:
+            return python_support->newFloat(*((double*)data));
+
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            return python_support->newLongLong(static_cast<long long>(*((qint64*)data)));
+
+        case QMetaType::QUrl:
+            return QStringToPyObject(value.toUrl().toString());
+
+        case QMetaType::QVariantMap:
+        {
+            const QVariantMap &map = *static_cast<const QVariantMap *>(data);
+            PyObject *py_dict = python_support->newDict();
+            for (auto iter = map.constBegin(); iter != map.constEnd(); ++iter)
+                python_support->dictSetItem(py_dict, QStringToPyObject(iter.key()), QVariantToPyObject(iter.value()));
+            return py_dict;
+        }
+
+        case QMetaType::QVariantList:
+        {
+            const QVariantList &list = *static_cast<const QVariantList *>(data);
+            PyObject *py_tuple = python_support->newTuple(list.size());
+            for (int i = 0; i < list.size(); ++i)
+                python_support->tupleSetItem(py_tuple, i, QVariantToPyObject(list.at(i)));
+            return py_tuple;
+        }
+
+        case QMetaType::QString:
+            return QStringToPyObject(*static_cast<const QString *>(data));
+
+        case QMetaType::QStringList:
+        {
+            const QStringList &list = *static_cast<const QStringList *>(data);
+            PyObject *py_tuple = python_support->newTuple(list.size());
+            for (int i = 0; i < list.size(); ++i)
+                python_support->tupleSetItem(py_tuple, i, QStringToPyObject(list.at(i)));
+            return py_tuple;
+        }
+
+        case QMetaType::QObjectStar:
+            return WrapQObject(value.value<QObject *>());
+
+        default:
+        {
+            if (type == PyObjectPtr_metaId())
+            {
+                return python_support->newReference(((PyObjectPtr *)data)->get());
+            }
+            else if (type == qMetaTypeId<QList<QUrl>>())
+            {
+                const QList<QUrl> &urls = *static_cast<const QList<QUrl> *>(data);
+                PyObject *py_tuple = python_support->newTuple(urls.size());
+                for (int i = 0; i < urls.size(); ++i)
+                    python_support->tupleSetItem(py_tuple, i, QStringToPyObject(urls.at(i).toString()));
+                return py_tuple;
+            }
+        }
+    }
+
+    return python_support->getNoneReturnValue();
 }
 
 QString lastVisitedDir;
@@ -902,6 +1073,52 @@ static PyObject *Canvas_connect(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_defineDisplayList(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int display_list_id = 0;
+    Py_buffer buffer;
+    PyObject *obj1 = NULL;
+    float x = 0.0;
+    float y = 0.0;
+    float width = 0.0;
+    float height = 0.0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oiw*Offff", &obj0, &display_list_id, &buffer, &obj1, &x, &y, &width, &height))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj1).toMap();
+
+    bool is_valid = false;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
+
+        DisplayListSharedPtr display_list(new DisplayList(command_buffer, imageMap, QRectF(x, y, width, height)));
+
+        is_valid = display_list->commands() != nullptr;
+
+        if (is_valid)
+            canvas->displayLists().define(display_list_id, display_list);
+    }
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Canvas_draw(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -920,7 +1137,7 @@ static PyObject *Canvas_draw(PyObject * /*self*/, PyObject *args)
     QVariantList raw_commands = PyObjectToQVariant(obj1).toList();
 
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         QList<CanvasDrawingCommand> drawing_commands;
 
@@ -954,18 +1171,29 @@ static PyObject *Canvas_draw_binary(PyObject * /*self*/, PyObject *args)
 
     QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj1).toMap();
 
+    bool is_valid = false;
+
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
 
         DrawingCommandsSharedPtr drawing_commands(new DrawingCommands(command_buffer, canvas->rect(), imageMap));
 
-        canvas->setBinarySectionCommands(0, drawing_commands);
+        is_valid = drawing_commands->isValid();
+
+        if (is_valid)
+            canvas->setBinarySectionCommands(0, drawing_commands);
     }
 
     PythonSupport::instance()->bufferRelease(&buffer);
 
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
@@ -979,8 +1207,9 @@ static PyObject *Canvas_drawSection_binary(PyObject * /*self*/, PyObject *args)
     int top = 0;
     int width = 0;
     int height = 0;
+    int force = 0;
 
-    if (!PythonSupport::instance()->parse()(args, "Oiw*Oiiii", &obj0, &section_id, &buffer, &obj1, &left, &top, &width, &height))
+    if (!PythonSupport::instance()->parse()(args, "Oiw*Oiiii|i", &obj0, &section_id, &buffer, &obj1, &left, &top, &width, &height, &force))
         return NULL;
 
     PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
@@ -991,21 +1220,84 @@ static PyObject *Canvas_drawSection_binary(PyObject * /*self*/, PyObject *args)
 
     float display_scaling = GetDisplayScaling();
 
+    bool is_valid = false;
+
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
 
         DrawingCommandsSharedPtr drawing_commands(new DrawingCommands(command_buffer, QRect(QPoint(left * display_scaling, top * display_scaling), QSize(width * display_scaling, height * display_scaling)), imageMap));
 
-        canvas->setBinarySectionCommands(section_id, drawing_commands);
+        is_valid = drawing_commands->isValid();
+
+        if (is_valid)
+            canvas->setBinarySectionCommands(section_id, drawing_commands, force != 0);
     }
 
     PythonSupport::instance()->bufferRelease(&buffer);
 
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_getDataProbe(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    float x = 0.0;
+    float y = 0.0;
+
+    if (!PythonSupport::instance()->parse()(args, "Off", &obj0, &x, &y))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    float display_scaling = GetDisplayScaling();
+
+    QVariantMap result;
+    bool found = false;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        found = canvas->probeData(QPointF(x * display_scaling, y * display_scaling), result);
+    }
+
+    if (!found)
+        return PythonSupport::instance()->getNoneReturnValue();
+
+    return QVariantToPyObject(result);
+}
+
+static PyObject *Canvas_getRenderStatistics(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "O", &obj0))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    QVariantMap statistics;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        statistics = canvas->renderStatistics();
+    }
+
+    return QVariantToPyObject(statistics);
+}
+
 static PyObject *Canvas_grabMouse(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -1024,6 +1316,84 @@ static PyObject *Canvas_grabMouse(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_hitTest(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    float x = 0.0;
+    float y = 0.0;
+
+    if (!PythonSupport::instance()->parse()(args, "Off", &obj0, &x, &y))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    float display_scaling = GetDisplayScaling();
+
+    QVariantList tags;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        for (quint32 tag : canvas->hitTest(QPointF(x * display_scaling, y * display_scaling)))
+            tags.append(static_cast<uint>(tag));
+    }
+
+    return QVariantToPyObject(tags);
+}
+
+static PyObject *Canvas_patchSection_binary(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int section_id = 0;
+    Py_buffer buffer;
+    PyObject *obj1 = NULL;
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+    int dirty_left = 0;
+    int dirty_top = 0;
+    int dirty_width = 0;
+    int dirty_height = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oiw*Oiiii|iiii", &obj0, &section_id, &buffer, &obj1, &left, &top, &width, &height, &dirty_left, &dirty_top, &dirty_width, &dirty_height))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+    {
+        PythonSupport::instance()->bufferRelease(&buffer);
+        return NULL;
+    }
+
+    QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj1).toMap();
+
+    float display_scaling = GetDisplayScaling();
+
+    bool is_valid = false;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        QRect rect(QPoint(left * display_scaling, top * display_scaling), QSize(width * display_scaling, height * display_scaling));
+        QRect dirty_rect(QPoint(dirty_left * display_scaling, dirty_top * display_scaling), QSize(dirty_width * display_scaling, dirty_height * display_scaling));
+
+        is_valid = canvas->patchBinarySectionCommands(section_id, (const quint32 *)buffer.buf, buffer.len / 4, rect, imageMap, dirty_rect);
+    }
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid command patches.");
+        return NULL;
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Canvas_releaseMouse(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -1040,6 +1410,27 @@ static PyObject *Canvas_releaseMouse(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_removeDisplayList(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int display_list_id = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oi", &obj0, &display_list_id))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        canvas->displayLists().remove(display_list_id);
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Canvas_removeSection(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -1057,6 +1448,32 @@ static PyObject *Canvas_removeSection(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_setCrosshair(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    int enabled = 0;
+    char *color_c = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "Oi|s", &obj0, &enabled, &color_c))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    QColor color = color_c ? ParseColorString(QString::fromUtf8(color_c)) : QColor(Qt::black);
+
+    canvas->setCrosshair(enabled != 0, color);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Canvas_setCursorShape(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -1120,6 +1537,192 @@ static PyObject *Canvas_setCursorShape(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Canvas_setDataReadout(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    int enabled = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oi", &obj0, &enabled))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    canvas->setDataReadout(enabled != 0);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Canvas_setOverlay_binary(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    Py_buffer buffer;
+    PyObject *obj1 = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "Ow*O", &obj0, &buffer, &obj1))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj1).toMap();
+
+    bool is_valid = false;
+    bool may_block = false;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
+
+        DrawingCommandsSharedPtr drawing_commands(new DrawingCommands(command_buffer, QRect(), imageMap));
+
+        is_valid = drawing_commands->isValid();
+
+        // the overlay is painted on the UI thread, which taking the GIL or sleeping would block.
+        may_block = is_valid && BinaryCommandsMayBlock(drawing_commands->paintCommands()->data(), static_cast<unsigned int>(drawing_commands->paintCommands()->size()));
+
+        if (is_valid && !may_block)
+            canvas->setOverlayCommands(drawing_commands);
+    }
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
+    if (may_block)
+    {
+        PythonSupport::instance()->setErrorString("Overlay commands cannot draw images, data, or arrays from the image map, or sleep.");
+        return NULL;
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Canvas_setSectionProgressive(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int section_id = 0;
+    int progressive = 0;
+    float preview_scale = 1.0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oii|f", &obj0, &section_id, &progressive, &preview_scale))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        canvas->setSectionProgressive(section_id, progressive != 0, preview_scale);
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Canvas_setSectionRenderMode(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int section_id = 0;
+    char *mode_c = NULL;
+    int promote_ms = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "Ois|i", &obj0, &section_id, &mode_c, &promote_ms))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    CanvasRenderOptions::RenderMode render_mode = CanvasRenderOptions::Balanced;
+
+    if (strcmp(mode_c, "interactive") == 0)
+        render_mode = CanvasRenderOptions::Interactive;
+    else if (strcmp(mode_c, "balanced") == 0)
+        render_mode = CanvasRenderOptions::Balanced;
+    else if (strcmp(mode_c, "quality") == 0)
+        render_mode = CanvasRenderOptions::Quality;
+    else
+    {
+        PythonSupport::instance()->setErrorString("Unknown render mode.");
+        return NULL;
+    }
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        canvas->setSectionRenderMode(section_id, render_mode, promote_ms);
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Canvas_setSectionStrokeSimplification(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int section_id = 0;
+    float tolerance = 0.0;
+
+    if (!PythonSupport::instance()->parse()(args, "Oif", &obj0, &section_id, &tolerance))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        canvas->setSectionStrokeSimplification(section_id, tolerance);
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Canvas_setSectionTransform(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int section_id = 0;
+    float m11 = 1.0;
+    float m12 = 0.0;
+    float m21 = 0.0;
+    float m22 = 1.0;
+    float dx = 0.0;
+    float dy = 0.0;
+    char *placeholder_color_c = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "Oiffffff|s", &obj0, &section_id, &m11, &m12, &m21, &m22, &dx, &dy, &placeholder_color_c))
+        return NULL;
+
+    PyCanvas *canvas = Unwrap<PyCanvas>(obj0);
+    if (canvas == NULL)
+        return NULL;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        QColor placeholder_color = placeholder_color_c ? ParseColorString(QString::fromUtf8(placeholder_color_c)) : QColor();
+
+        canvas->setSectionTransform(section_id, QTransform(m11, m12, m21, m22, dx, dy), placeholder_color);
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *CheckBox_connect(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -1564,6 +2167,50 @@ QFont ParseFontString(const QString &font_string, float display_scaling = 1.0)
     return font;
 }
 
+static PyObject *Core_benchmarkConversion(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *obj0 = NULL;
+    int iterations = 1;
+
+    if (!PythonSupport::instance()->parse()(args, "O|i", &obj0, &iterations))
+        return NULL;
+
+    iterations = qMax(iterations, 1);
+
+    // compare the direct converters with the PythonValueVariant converters. all conversions require the GIL.
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        PythonValueVariantToQVariant(PyObjectToValueVariant(obj0));
+    qint64 legacy_to_qvariant_ns = timer.nsecsElapsed() / iterations;
+
+    QVariant value;
+
+    timer.restart();
+    for (int i = 0; i < iterations; ++i)
+        value = PyObjectToQVariant(obj0);
+    qint64 direct_to_qvariant_ns = timer.nsecsElapsed() / iterations;
+
+    timer.restart();
+    for (int i = 0; i < iterations; ++i)
+        PyObjectPtr py_object(PythonValueVariantToPyObject(QVariantToPythonValueVariant(value)));
+    qint64 legacy_to_pyobject_ns = timer.nsecsElapsed() / iterations;
+
+    timer.restart();
+    for (int i = 0; i < iterations; ++i)
+        PyObjectPtr py_object(QVariantToPyObject(value));
+    qint64 direct_to_pyobject_ns = timer.nsecsElapsed() / iterations;
+
+    QVariantMap result;
+    result["legacy_to_qvariant_ns"] = legacy_to_qvariant_ns;
+    result["direct_to_qvariant_ns"] = direct_to_qvariant_ns;
+    result["legacy_to_pyobject_ns"] = legacy_to_pyobject_ns;
+    result["direct_to_pyobject_ns"] = direct_to_pyobject_ns;
+
+    return QVariantToPyObject(result);
+}
+
 static PyObject *Core_getFontMetrics(PyObject * /*self*/, PyObject *args)
 {
     char *font_c = NULL;
@@ -1590,6 +2237,41 @@ static PyObject *Core_getFontMetrics(PyObject * /*self*/, PyObject *args)
     return QVariantToPyObject(result);
 }
 
+static PyObject *Core_getGILStatistics(PyObject * /*self*/, PyObject *args)
+{
+    int reset = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "|i", &reset))
+        return NULL;
+
+    std::map<std::string, GILCallSiteStatistics> statistics;
+    GetGILStatistics(statistics, reset != 0);
+
+    auto histogram_map = [](const GILDurationHistogram &histogram) {
+        QVariantList buckets;
+        for (auto bucket : histogram.buckets)
+            buckets.append(static_cast<qulonglong>(bucket));
+        QVariantMap histogram_map;
+        histogram_map["count"] = static_cast<qulonglong>(histogram.count);
+        histogram_map["total_ns"] = static_cast<qulonglong>(histogram.total_ns);
+        histogram_map["max_ns"] = static_cast<qulonglong>(histogram.max_ns);
+        histogram_map["buckets"] = buckets;
+        return histogram_map;
+    };
+
+    QVariantMap result;
+
+    for (const auto &entry : statistics)
+    {
+        QVariantMap call_site;
+        call_site["wait"] = histogram_map(entry.second.wait);
+        call_site["hold"] = histogram_map(entry.second.hold);
+        result[QString::fromStdString(entry.first)] = call_site;
+    }
+
+    return QVariantToPyObject(result);
+}
+
 static PyObject *Core_getQtVersion(PyObject * /*self*/, PyObject *args)
 {
     Q_UNUSED(args)
@@ -1651,44 +2333,440 @@ static PyObject *Core_getLocation(PyObject * /*self*/, PyObject *args)
     data_location = dir.absolutePath();
     QDir().mkpath(data_location);
 
-    return PythonSupport::instance()->build()("s", data_location.toUtf8().data());
+    return PythonSupport::instance()->build()("s", data_location.toUtf8().data());
+}
+
+static PyObject *Core_out(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *output_u = NULL;
+    if (!PythonSupport::instance()->parse()(args, "O", &output_u))
+        return NULL;
+
+    QString output = PyObjectToQString(output_u);
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        output = output.trimmed();
+        if (!output.isEmpty())
+        {
+            QTextStream cout(stdout);
+            cout << (const char *)(output.toUtf8().data()) << Qt::endl;
+
+            QTextStream textStream(&static_cast<Application *>(qApp)->getLogFile());
+            textStream << (const char *)(output.toUtf8().data()) << Qt::endl;
+        }
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+static PyObject *Core_pathToURL(PyObject * /*self*/, PyObject *args)
+{
+    PyObject *path_u = NULL;
+    if (!PythonSupport::instance()->parse()(args, "O", &path_u))
+        return NULL;
+
+    QUrl url = QUrl::fromLocalFile(PyObjectToQString(path_u));
+    QString url_string = url.toString();
+
+    return PythonSupport::instance()->build()("s", url_string.toUtf8().data());
+}
+
+/*
+ Native tests of launcher internals that cannot be exercised from Python, run by nionui_app.test_native.
+
+ Each test appends a description of each failed check to the failures.
+ */
+#define NATIVE_TEST_CHECK(condition) if (!(condition)) failures.append(QString("%1: %2").arg(__func__, #condition))
+
+static void InsertLayer(LayerCache &layers, quint32 key, quint32 version, quint64 raster_mode, int size)
+{
+    QImage raster_image(size, size, QImage::Format_ARGB32_Premultiplied);
+    layers.insert(key, version, QTransform(), raster_mode, QRect(0, 0, size, size), raster_image, QVector<TaggedBounds>(), DataProbes());
+}
+
+static bool FindLayer(LayerCache &layers, quint32 key, quint32 version, quint64 raster_mode)
+{
+    QRect raster_rect;
+    QImage raster_image;
+    QVector<TaggedBounds> raster_tagged_bounds;
+    DataProbes raster_data_probes;
+    return layers.find(key, version, QTransform(), raster_mode, raster_rect, raster_image, raster_tagged_bounds, raster_data_probes);
 }
 
-static PyObject *Core_out(PyObject * /*self*/, PyObject *args)
+static qlonglong LayerStatistic(LayerCache &layers, const QString &name)
 {
-    PyObject *output_u = NULL;
-    if (!PythonSupport::instance()->parse()(args, "O", &output_u))
-        return NULL;
+    QVariantMap statistics;
+    layers.getStatistics(statistics);
+    return statistics.value(name).toLongLong();
+}
 
-    QString output = PyObjectToQString(output_u);
+static void TestLayerCache(QStringList &failures)
+{
+    LayerCache layers;
 
-    {
-        Python_ThreadAllow thread_allow;
+    InsertLayer(layers, 1, 1, 0, 100);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 1);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_bytes") == 100 * 100 * 4);
+    NATIVE_TEST_CHECK(FindLayer(layers, 1, 1, 0));
+    NATIVE_TEST_CHECK(!FindLayer(layers, 1, 2, 0));
+    NATIVE_TEST_CHECK(!FindLayer(layers, 1, 1, 1));
+    NATIVE_TEST_CHECK(!FindLayer(layers, 2, 1, 0));
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_hits") == 1);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_misses") == 3);
 
-        output = output.trimmed();
-        if (!output.isEmpty())
-        {
-            QTextStream cout(stdout);
-            cout << (const char *)(output.toUtf8().data()) << Qt::endl;
+    // a new version replaces the raster and its bytes.
+    InsertLayer(layers, 1, 2, 0, 50);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 1);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_bytes") == 50 * 50 * 4);
+    NATIVE_TEST_CHECK(!FindLayer(layers, 1, 1, 0));
+    NATIVE_TEST_CHECK(FindLayer(layers, 1, 2, 0));
 
-            QTextStream textStream(&static_cast<Application *>(qApp)->getLogFile());
-            textStream << (const char *)(output.toUtf8().data()) << Qt::endl;
+    // the rasters of other raster modes are kept, so that preview and final passes do not evict each other.
+    InsertLayer(layers, 1, 2, 1, 50);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 2);
+    NATIVE_TEST_CHECK(FindLayer(layers, 1, 2, 0));
+    NATIVE_TEST_CHECK(FindLayer(layers, 1, 2, 1));
+    InsertLayer(layers, 1, 3, 1, 50);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 1);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_bytes") == 50 * 50 * 4);
+
+    layers.clear();
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 0);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_bytes") == 0);
+
+    // four 16 MB rasters fill the 64 MB limit (MAX_LAYER_CACHE_BYTES); a fifth evicts the least recently used one.
+    for (quint32 key = 10; key < 14; ++key)
+        InsertLayer(layers, key, 1, 0, 2048);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 4);
+    NATIVE_TEST_CHECK(FindLayer(layers, 10, 1, 0));
+    InsertLayer(layers, 14, 1, 0, 2048);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 4);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_bytes") == 4 * 2048 * 2048 * 4LL);
+    NATIVE_TEST_CHECK(FindLayer(layers, 10, 1, 0));
+    NATIVE_TEST_CHECK(!FindLayer(layers, 11, 1, 0));
+    NATIVE_TEST_CHECK(FindLayer(layers, 14, 1, 0));
+
+    // a raster larger than the limit is kept until another one is inserted.
+    InsertLayer(layers, 15, 1, 0, 4500);
+    NATIVE_TEST_CHECK(LayerStatistic(layers, "layer_cache_count") == 1);
+    NATIVE_TEST_CHECK(FindLayer(layers, 15, 1, 0));
+}
+
+static void TestBinaryCommandsPatches(QStringList &failures)
+{
+    const std::vector<quint32> commands = { 1, 2, 3, 4, 5, 6 };
+    std::vector<quint32> patched_commands;
+
+    // replace 2 and 3 with 7, remove 5, and append 8 and 9.
+    const quint32 patches[] = { 1, 2, 1, 7, 4, 1, 0, 6, 0, 2, 8, 9 };
+    NATIVE_TEST_CHECK(ApplyBinaryCommandsPatches(commands, patches, 12, patched_commands));
+    NATIVE_TEST_CHECK(patched_commands == std::vector<quint32>({ 1, 7, 4, 6, 8, 9 }));
+
+    NATIVE_TEST_CHECK(ApplyBinaryCommandsPatches(commands, patches, 0, patched_commands));
+    NATIVE_TEST_CHECK(patched_commands == commands);
+
+    // the first patch of a section applies to no commands.
+    const quint32 insert_patches[] = { 0, 0, 2, 8, 9 };
+    NATIVE_TEST_CHECK(ApplyBinaryCommandsPatches(std::vector<quint32>(), insert_patches, 5, patched_commands));
+    NATIVE_TEST_CHECK(patched_commands == std::vector<quint32>({ 8, 9 }));
+
+    const quint32 overlapping_patches[] = { 1, 2, 0, 2, 1, 0 };
+    NATIVE_TEST_CHECK(!ApplyBinaryCommandsPatches(commands, overlapping_patches, 6, patched_commands));
+
+    const quint32 decreasing_patches[] = { 3, 0, 0, 1, 0, 0 };
+    NATIVE_TEST_CHECK(!ApplyBinaryCommandsPatches(commands, decreasing_patches, 6, patched_commands));
+
+    const quint32 out_of_range_patches[] = { 5, 2, 0 };
+    NATIVE_TEST_CHECK(!ApplyBinaryCommandsPatches(commands, out_of_range_patches, 3, patched_commands));
+
+    const quint32 truncated_patches[] = { 1, 0, 2, 7 };
+    NATIVE_TEST_CHECK(!ApplyBinaryCommandsPatches(commands, truncated_patches, 4, patched_commands));
+    NATIVE_TEST_CHECK(!ApplyBinaryCommandsPatches(commands, truncated_patches, 2, patched_commands));
+}
+
+// append a v1 command word; commands are stored as their four characters.
+static void AppendCommand(std::vector<quint32> &commands, quint32 command)
+{
+    commands.push_back(qbswap(command));
+}
+
+static void AppendFloat(std::vector<quint32> &commands, float value)
+{
+    quint32 word;
+    memcpy(&word, &value, 4);
+    commands.push_back(word);
+}
+
+static void AppendString(std::vector<quint32> &commands, const QByteArray &string)
+{
+    commands.push_back(static_cast<quint32>(string.size()));
+    size_t index = commands.size();
+    commands.resize(index + (string.size() + 3) / 4, 0);
+    memcpy(&commands[index], string.constData(), string.size());
+}
+
+static std::vector<quint32> BinaryCommandsV1Example()
+{
+    std::vector<quint32> nested_commands;
+    AppendCommand(nested_commands, 0x72656374);  // rect
+    for (float value : { 0.0f, 0.0f, 10.0f, 10.0f })
+        AppendFloat(nested_commands, value);
+    AppendCommand(nested_commands, 0x66696c6c);  // fill
+
+    std::vector<quint32> commands;
+    AppendCommand(commands, 0x73617665);  // save
+    AppendCommand(commands, 0x6d6f7665);  // move
+    AppendFloat(commands, 1.0f);
+    AppendFloat(commands, 2.0f);
+    AppendCommand(commands, 0x6c696e65);  // line
+    AppendFloat(commands, 3.5f);
+    AppendFloat(commands, -4.0f);
+    AppendCommand(commands, 0x61726320);  // arc
+    for (float value : { 5.0f, 6.0f, 7.0f, 0.25f, 3.14159f })
+        AppendFloat(commands, value);
+    commands.push_back(1);
+    AppendCommand(commands, 0x666c7374);  // flst
+    AppendString(commands, "red");
+    AppendCommand(commands, 0x73747374);  // stst
+    AppendString(commands, "red");
+    AppendCommand(commands, 0x666f6e74);  // font
+    AppendString(commands, "normal 12px serif");
+    AppendCommand(commands, 0x69746167);  // itag
+    commands.push_back(300000);
+    AppendCommand(commands, 0x6c61746e);  // latn
+    double latency = 1.5;
+    commands.resize(commands.size() + 2);
+    memcpy(&commands[commands.size() - 2], &latency, 8);
+    AppendCommand(commands, 0x706c796c);  // plyl
+    commands.push_back(0);
+    commands.push_back(2);
+    AppendFloat(commands, 0.1f);
+    AppendFloat(commands, 0.2f);
+    AppendCommand(commands, 0x6466646c);  // dfdl
+    commands.push_back(5);
+    for (float value : { 0.0f, 0.0f, 10.0f, 10.0f })
+        AppendFloat(commands, value);
+    commands.push_back(static_cast<quint32>(nested_commands.size()));
+    commands.insert(commands.end(), nested_commands.begin(), nested_commands.end());
+    AppendCommand(commands, 0x72657374);  // rest
+    return commands;
+}
+
+static void TestBinaryCommandsV2(QStringList &failures)
+{
+    const std::vector<quint32> commands = BinaryCommandsV1Example();
+    const unsigned int command_count = static_cast<unsigned int>(commands.size());
+
+    // the coordinates of the example are exact in float16.
+    for (quint32 flags = 0; flags < 4; ++flags)
+    {
+        std::vector<quint32> encoded_commands;
+        std::vector<quint32> decoded_commands;
+        NATIVE_TEST_CHECK(EncodeBinaryCommandsV2(commands.data(), command_count, flags, encoded_commands));
+        NATIVE_TEST_CHECK(IsBinaryCommandsV2(encoded_commands.data(), static_cast<unsigned int>(encoded_commands.size())));
+        NATIVE_TEST_CHECK(!IsBinaryCommandsV2(commands.data(), command_count));
+        NATIVE_TEST_CHECK(DecodeBinaryCommandsV2(encoded_commands.data(), static_cast<unsigned int>(encoded_commands.size()), decoded_commands));
+        NATIVE_TEST_CHECK(decoded_commands == commands);
+
+        // the repeated string is stored once.
+        NATIVE_TEST_CHECK(encoded_commands.size() > 2 && encoded_commands[2] == 2);
+
+        // the stream is decoded when it is submitted.
+        CommandsSharedPtr decoded_commands_ptr = DecodeBinaryCommands(CommandsSharedPtr(new std::vector<quint32>(encoded_commands)));
+        NATIVE_TEST_CHECK(decoded_commands_ptr && *decoded_commands_ptr == commands);
+
+        // every truncation of the stream is rejected.
+        for (unsigned int count = 0; count < encoded_commands.size(); ++count)
+        {
+            if (DecodeBinaryCommandsV2(encoded_commands.data(), count, decoded_commands))
+                failures.append(QString("%1: truncated stream of %2 words with flags %3 is accepted").arg(__func__).arg(count).arg(flags));
         }
+        NATIVE_TEST_CHECK(!DecodeBinaryCommands(CommandsSharedPtr(new std::vector<quint32>(encoded_commands.begin(), encoded_commands.end() - 1))));
     }
 
-    return PythonSupport::instance()->getNoneReturnValue();
+    const quint32 magic = 0x3230434e;  // NC02
+    std::vector<quint32> decoded_commands;
+
+    // an opcode missing from the schema.
+    const quint32 unknown_opcode[] = { magic, 0, 0, 1, 0xFF };
+    NATIVE_TEST_CHECK(!DecodeBinaryCommandsV2(unknown_opcode, 5, decoded_commands));
+
+    // a stat command with a string index beyond the string table.
+    const quint32 unknown_string[] = { magic, 0, 0, 5, 23, 0 };
+    NATIVE_TEST_CHECK(!DecodeBinaryCommandsV2(unknown_string, 6, decoded_commands));
+
+    // a body length beyond the stream.
+    const quint32 long_body[] = { magic, 0, 0, 8, 0 };
+    NATIVE_TEST_CHECK(!DecodeBinaryCommandsV2(long_body, 5, decoded_commands));
+
+    // a dfdl command with varint display list id 0, zero bounds, and a nested body longer than the enclosing body.
+    quint8 dfdl_body[20] = { 19, 0 };
+    dfdl_body[18] = 64;
+    std::vector<quint32> long_nested_body = { magic, 2, 0, 19 };
+    long_nested_body.resize(9);
+    memcpy(&long_nested_body[4], dfdl_body, 20);
+    NATIVE_TEST_CHECK(!DecodeBinaryCommandsV2(long_nested_body.data(), 9, decoded_commands));
+
+    // v1 commands missing from the schema or with truncated arguments cannot be encoded.
+    std::vector<quint32> encoded_commands;
+    std::vector<quint32> unknown_command;
+    AppendCommand(unknown_command, 0x78787878);
+    NATIVE_TEST_CHECK(!EncodeBinaryCommandsV2(unknown_command.data(), 1, 0, encoded_commands));
+    NATIVE_TEST_CHECK(!EncodeBinaryCommandsV2(commands.data(), 2, 0, encoded_commands));
+}
+
+static void TestHitTestIndex(QStringList &failures)
+{
+    // overlapping entries, a duplicate tag, an entry spanning cells, and an entry too large for the grid.
+    QVector<TaggedBounds> entries;
+    entries.append(TaggedBounds(QRectF(0, 0, 100, 100), 1));
+    entries.append(TaggedBounds(QRectF(50, 50, 100, 100), 2));
+    entries.append(TaggedBounds(QRectF(60, 60, 10, 10), 1));
+    entries.append(TaggedBounds(QRectF(-500, -500, 5000, 5000), 3));
+    entries.append(TaggedBounds(QRectF(200, 200, 10, 10), 4));
+    HitTestIndex hit_test_index(entries);
+
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(65, 65)) == QVector<quint32>({ 3, 1, 2 }));
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(10, 10)) == QVector<quint32>({ 3, 1 }));
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(140, 140)) == QVector<quint32>({ 3, 2 }));
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(205, 205)) == QVector<quint32>({ 4, 3 }));
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(-100, 1000)) == QVector<quint32>({ 3 }));
+    NATIVE_TEST_CHECK(hit_test_index.hitTest(QPointF(6000, 6000)).isEmpty());
+
+    NATIVE_TEST_CHECK(HitTestIndex(QVector<TaggedBounds>()).hitTest(QPointF(0, 0)).isEmpty());
+}
+
+// take the events recorded by the delegate, each formatted as the method followed by its arguments.
+static QStringList TakeDelegateEvents(const QVariant &delegate)
+{
+    Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+
+    QStringList events;
+    for (const auto &event : app->dispatchPyMethod(delegate, "takeEvents", QVariantList()).toList())
+    {
+        QStringList words(event.toList().value(0).toString());
+        for (const auto &arg : event.toList().value(1).toList())
+            words.append(arg.toString());
+        events.append(words.join(" "));
+    }
+    return events;
+}
+
+static void TestEventCoalescer(QStringList &failures, const QVariant &delegate)
+{
+    QWidget widget;
+    EventCoalescer event_coalescer(&widget, delegate);
+    event_coalescer.setPolicy(EventCoalescer::Coalesced);
+
+    // events with the same method merge into the first pending one; deltas (here the third and fourth arguments) add.
+    event_coalescer.queue("mouseMoved", QVariantList() << 10 << 20);
+    event_coalescer.accumulate("wheelChanged", QVariantList() << 10 << 20 << 1 << 2 << 0, 2, 2);
+    event_coalescer.queue("mouseMoved", QVariantList() << 11 << 21);
+    event_coalescer.accumulate("wheelChanged", QVariantList() << 11 << 21 << 3 << 4 << 0, 2, 2);
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate).isEmpty());
+    event_coalescer.flush();
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "mouseMoved 11 21", "wheelChanged 11 21 4 6 0" }));
+
+    // deltas with different qualifiers do not merge.
+    event_coalescer.accumulate("wheelChanged", QVariantList() << 0 << 0 << 1 << 1 << 0, 2, 2);
+    event_coalescer.accumulate("wheelChanged", QVariantList() << 0 << 0 << 1 << 1 << 1, 2, 2);
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "wheelChanged 0 0 1 1 0" }));
+    event_coalescer.flush();
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "wheelChanged 0 0 1 1 1" }));
+
+    // nothing is pending after a flush.
+    event_coalescer.flush();
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate).isEmpty());
+
+    // a posted event is dispatched after the pending events.
+    event_coalescer.queue("mouseMoved", QVariantList() << 12 << 22);
+    event_coalescer.post("mousePressed", QVariantList() << 12 << 22);
+    event_coalescer.queue("mouseMoved", QVariantList() << 13 << 23);
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "mouseMoved 12 22", "mousePressed 12 22" }));
+
+    // a change of policy dispatches the pending events, after which events are dispatched immediately.
+    event_coalescer.setPolicy(EventCoalescer::Immediate);
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "mouseMoved 13 23" }));
+    event_coalescer.queue("mouseMoved", QVariantList() << 14 << 24);
+    event_coalescer.post("mouseReleased", QVariantList() << 14 << 24);
+    NATIVE_TEST_CHECK(TakeDelegateEvents(delegate) == QStringList({ "mouseMoved 14 24", "mouseReleased 14 24" }));
+
+    QVariantMap statistics;
+    event_coalescer.getStatistics(statistics);
+    NATIVE_TEST_CHECK(statistics["queued_count"].toInt() == 11);
+    NATIVE_TEST_CHECK(statistics["merged_count"].toInt() == 2);
+    NATIVE_TEST_CHECK(statistics["dispatched_count"].toInt() == 9);
+}
+
+static void TestItemModel(QStringList &failures, const QVariant &delegate)
+{
+    // the delegate answers the queries that are not cached: 7 rows, each with id 100 and value "python".
+    ItemModel item_model;
+    item_model.setPyObject(delegate);
+    item_model.setRows(0, QVariantList() << QVariant(QVariantList() << 1 << "a") << QVariant(QVariantList() << 2 << "b" << "B"));
+    item_model.setRows(1, QVariantList() << QVariant(QVariantList() << 11 << "c"));
+
+    QModelIndex item_index_1 = item_model.index(0, 0, QModelIndex());
+    NATIVE_TEST_CHECK(item_model.rowCount(QModelIndex()) == 2);
+    NATIVE_TEST_CHECK(item_index_1.internalId() == 1);
+    NATIVE_TEST_CHECK(item_model.data(item_model.index(1, 0, QModelIndex()), Qt::DisplayRole).toString() == "b");
+    NATIVE_TEST_CHECK(item_model.data(item_model.index(1, 0, QModelIndex()), Qt::EditRole).toString() == "B");
+    NATIVE_TEST_CHECK(item_model.rowCount(item_index_1) == 1);
+    NATIVE_TEST_CHECK(item_model.parent(item_model.index(0, 0, item_index_1)) == item_index_1);
+
+    // a data change invalidates the values of the item only.
+    item_model.dataChangedInParent(1, -1, 0);
+    NATIVE_TEST_CHECK(item_model.data(item_model.index(1, 0, QModelIndex()), Qt::DisplayRole).toString() == "python");
+    NATIVE_TEST_CHECK(item_model.data(item_model.index(0, 0, QModelIndex()), Qt::DisplayRole).toString() == "a");
+
+    // inserting rows drops the children of the parent, but not those of its children.
+    item_model.beginInsertRowsInParent(2, 2, -1, 0);
+    item_model.endInsertRowsInParent();
+    NATIVE_TEST_CHECK(item_model.rowCount(QModelIndex()) == 7);
+    NATIVE_TEST_CHECK(item_model.indexInParent(0, 0, 1).internalId() == 11);
+
+    // removing rows drops the children of the parent and the removed items with their descendants.
+    item_model.setRows(0, QVariantList() << QVariant(QVariantList() << 1 << "a") << QVariant(QVariantList() << 2 << "b") << QVariant(QVariantList() << 3 << "d"));
+    NATIVE_TEST_CHECK(item_model.rowCount(QModelIndex()) == 3);
+    item_model.beginRemoveRowsInParent(0, 0, -1, 0);
+    item_model.endRemoveRowsInParent();
+    NATIVE_TEST_CHECK(item_model.rowCount(QModelIndex()) == 7);
+    NATIVE_TEST_CHECK(item_model.indexInParent(0, 0, 1).internalId() == 100);
+
+    TakeDelegateEvents(delegate);
 }
 
-static PyObject *Core_pathToURL(PyObject * /*self*/, PyObject *args)
+/*
+ Run the native tests. The delegate records the methods dispatched to it as events and answers the item model
+ queries (see nionui_app.test_native).
+ Returns a list of the failed checks, which is empty if all tests pass.
+ */
+static PyObject *Core_runNativeTests(PyObject * /*self*/, PyObject *args)
 {
-    PyObject *path_u = NULL;
-    if (!PythonSupport::instance()->parse()(args, "O", &path_u))
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
         return NULL;
+    }
 
-    QUrl url = QUrl::fromLocalFile(PyObjectToQString(path_u));
-    QString url_string = url.toString();
+    PyObject *obj0 = NULL;
+    if (!PythonSupport::instance()->parse()(args, "O", &obj0))
+        return NULL;
 
-    return PythonSupport::instance()->build()("s", url_string.toUtf8().data());
+    QVariant delegate = PyObjectToQVariant(obj0);
+
+    QStringList failures;
+
+    TestLayerCache(failures);
+    TestBinaryCommandsPatches(failures);
+    TestBinaryCommandsV2(failures);
+    TestHitTestIndex(failures);
+    TestEventCoalescer(failures, delegate);
+    TestItemModel(failures, delegate);
+
+    return QVariantToPyObject(QVariant(failures).toList());
 }
 
 static PyObject *Core_setApplicationInfo(PyObject * /*self*/, PyObject *args)
@@ -1709,6 +2787,27 @@ static PyObject *Core_setApplicationInfo(PyObject * /*self*/, PyObject *args)
 QElapsedTimer timer;
 qint64 timer_offset_ns = 0;
 
+static PyObject *Core_setGILInstrumentation(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    int enabled = 0;
+    int log_interval_ms = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "i|i", &enabled, &log_interval_ms))
+        return NULL;
+
+    SetGILInstrumentationEnabled(enabled != 0);
+
+    Application::instance()->setGILStatisticsLogInterval(enabled != 0 ? log_interval_ms : 0);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Core_syncLatencyTimer(PyObject * /*self*/, PyObject *args)
 {
     double value = 0.0;
@@ -2043,7 +3142,7 @@ static PyObject *DocumentWindow_getColorDialog(PyObject * /*self*/, PyObject *ar
     QString result(color_c);
 
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
         QColorDialog dialog(color, document_window);
         dialog.setOption(QColorDialog::ShowAlphaChannel, show_alpha);
         if (dialog.exec() == QDialog::Accepted) {
@@ -2126,7 +3225,7 @@ static PyObject *DocumentWindow_getFilePath(PyObject * /*self*/, PyObject *args)
 
         QString ret;
         {
-            Python_ThreadAllow thread_allow;
+            Python_ThreadAllow thread_allow(__func__);
             ret = GetSaveFileName(document_window, caption, dir, filter, &selected_filter, &selected_dir);
         }
         QVariantList result;
@@ -2143,7 +3242,7 @@ static PyObject *DocumentWindow_getFilePath(PyObject * /*self*/, PyObject *args)
 
         QString ret;
         {
-            Python_ThreadAllow thread_allow;
+            Python_ThreadAllow thread_allow(__func__);
             ret = GetOpenFileName(document_window, caption, dir, filter, &selected_filter, &selected_dir);
         }
 
@@ -2160,7 +3259,7 @@ static PyObject *DocumentWindow_getFilePath(PyObject * /*self*/, PyObject *args)
         QDir::setCurrent(dir);
         QString directory;
         {
-            Python_ThreadAllow thread_allow;
+            Python_ThreadAllow thread_allow(__func__);
             directory = GetExistingDirectory(document_window, caption, dir, &selected_dir);
         }
 
@@ -2178,7 +3277,7 @@ static PyObject *DocumentWindow_getFilePath(PyObject * /*self*/, PyObject *args)
 
         QStringList file_names;
         {
-            Python_ThreadAllow thread_allow;
+            Python_ThreadAllow thread_allow(__func__);
             file_names = GetOpenFileNames(document_window, caption, dir, filter, &selected_filter, &selected_dir);
         }
 
@@ -2733,7 +3832,7 @@ static PyObject *DrawingContext_drawCommands(PyObject * /*self*/, PyObject *args
     QVariantList raw_commands = PyObjectToQVariant(obj1).toList();
 
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         Q_FOREACH(const QVariant &raw_command_variant, raw_commands)
         {
@@ -2766,7 +3865,7 @@ static PyObject *DrawingContext_paintRGBAToImage(PyObject * /*self*/, PyObject *
 
     if (width > 0 && height > 0)
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         QImageInterface image;
         image.create(width, height, ImageFormat::Format_ARGB32);
@@ -2797,6 +3896,123 @@ static PyObject *DrawingContext_paintRGBAToImage(PyObject * /*self*/, PyObject *
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+/*
+ Encode v1 binary commands as v2 into the output buffer.
+
+ Returns the byte length of the v2 commands. Nothing is written if the output buffer is too small, in which case
+ the caller should call again with a buffer of at least the returned length.
+ */
+static PyObject *DrawingContext_encodeBinary_v2(PyObject * /*self*/, PyObject *args)
+{
+    Py_buffer buffer;
+    Py_buffer encoded_buffer;
+    int flags = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "w*w*|i", &buffer, &encoded_buffer, &flags))
+        return NULL;
+
+    std::vector<quint32> encoded_commands;
+    bool is_valid = false;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        is_valid = EncodeBinaryCommandsV2((const quint32 *)buffer.buf, buffer.len / 4, flags, encoded_commands);
+
+        if (is_valid && encoded_commands.size() * 4 <= (size_t)encoded_buffer.len)
+            memcpy(encoded_buffer.buf, encoded_commands.data(), encoded_commands.size() * 4);
+    }
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+    PythonSupport::instance()->bufferRelease(&encoded_buffer);
+
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Unable to encode binary commands.");
+        return NULL;
+    }
+
+    return QVariantToPyObject(static_cast<qlonglong>(encoded_commands.size() * 4));
+}
+
+/*
+ Measure recorded v1 or v2 binary commands.
+
+ Returns a dict with the version, the byte length, the byte length decoded to v1, the mean time to decode to v1,
+ and, if a width and height are passed, the mean time to paint into an image of that size.
+ */
+static PyObject *DrawingContext_benchmarkBinary(PyObject * /*self*/, PyObject *args)
+{
+    Py_buffer buffer;
+    PyObject *obj0 = NULL;
+    int iterations = 1;
+    int width = 0;
+    int height = 0;
+
+    if (!PythonSupport::instance()->parse()(args, "w*O|iii", &buffer, &obj0, &iterations, &width, &height))
+        return NULL;
+
+    QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj0).toMap();
+
+    iterations = qMax(iterations, 1);
+
+    QVariantMap result;
+    bool is_valid = true;
+
+    {
+        Python_ThreadAllow thread_allow(__func__);
+
+        CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
+
+        bool is_v2 = IsBinaryCommandsV2(command_buffer->data(), static_cast<unsigned int>(command_buffer->size()));
+
+        std::vector<quint32> decoded_commands(*command_buffer);
+
+        QElapsedTimer decode_timer;
+        decode_timer.start();
+
+        for (int i = 0; is_v2 && is_valid && i < iterations; ++i)
+            is_valid = DecodeBinaryCommandsV2(command_buffer->data(), static_cast<unsigned int>(command_buffer->size()), decoded_commands);
+
+        qint64 decode_ns = is_v2 ? decode_timer.nsecsElapsed() / iterations : 0;
+
+        qint64 paint_ns = 0;
+
+        if (is_valid && width > 0 && height > 0)
+        {
+            QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+
+            QElapsedTimer paint_timer;
+            paint_timer.start();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                QPainter painter(&image);
+                painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing);
+                PaintBinaryCommands(&painter, command_buffer, imageMap, RenderedTimeStamps(), 1.0);
+            }
+
+            paint_ns = paint_timer.nsecsElapsed() / iterations;
+        }
+
+        result["version"] = is_v2 ? 2 : 1;
+        result["bytes"] = static_cast<qlonglong>(command_buffer->size() * 4);
+        result["v1_bytes"] = static_cast<qlonglong>(decoded_commands.size() * 4);
+        result["decode_ns"] = decode_ns;
+        result["paint_ns"] = paint_ns;
+    }
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+
+    if (!is_valid)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
+    return QVariantToPyObject(result);
+}
+
 static PyObject *DrawingContext_paintRGBAToImage_binary(PyObject * /*self*/, PyObject *args)
 {
     Py_buffer buffer;
@@ -2814,7 +4030,7 @@ static PyObject *DrawingContext_paintRGBAToImage_binary(PyObject * /*self*/, PyO
 
     if (width > 0 && height > 0)
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
 
         QImageInterface image;
         image.create(width, height, ImageFormat::Format_ARGB32);
@@ -3042,6 +4258,41 @@ static PyObject *ItemModel_endRemoveRow(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *ItemModel_setRows(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    int parent_item_id = 0;
+    PyObject *obj1 = NULL;
+    if (!PythonSupport::instance()->parse()(args, "OiO", &obj0, &parent_item_id, &obj1))
+        return NULL;
+
+    // Grab the item controller (a python object)
+    ItemModel *py_item_model = Unwrap<ItemModel>(obj0);
+    if (py_item_model == NULL)
+        return NULL;
+
+    QVariantList rows = PyObjectToQVariant(obj1).toList();
+
+    for (const auto &row : rows)
+    {
+        if (row.toList().isEmpty())
+        {
+            PythonSupport::instance()->setErrorString("Each row must be a list of item id, display value, and optional edit value.");
+            return NULL;
+        }
+    }
+
+    py_item_model->setRows(parent_item_id, rows);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Label_setTextAlignmentHorizontal(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -4448,6 +5699,31 @@ static PyObject *StackWidget_setCurrentIndex(PyObject * /*self*/, PyObject *args
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *StyledDelegate_clearItemCommands(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    int item_id = -1;
+    if (!PythonSupport::instance()->parse()(args, "O|i", &obj0, &item_id))
+        return NULL;
+
+    PyStyledItemDelegate *delegate = Unwrap<PyStyledItemDelegate>(obj0);
+    if (delegate == NULL)
+        return NULL;
+
+    if (item_id < 0)
+        delegate->clearAllItemCommands();
+    else
+        delegate->clearItemCommands(item_id);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *StyledDelegate_connect(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -4487,6 +5763,48 @@ static PyObject *StyledDelegate_create(PyObject * /*self*/, PyObject *args)
     return WrapQObject(delegate);
 }
 
+static PyObject *StyledDelegate_setItemCommands_binary(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    int item_id = 0;
+    PY_LONG_LONG version = 0;
+    Py_buffer buffer;
+    PyObject *obj1 = NULL;
+    if (!PythonSupport::instance()->parse()(args, "OiLw*O", &obj0, &item_id, &version, &buffer, &obj1))
+        return NULL;
+
+    PyStyledItemDelegate *delegate = Unwrap<PyStyledItemDelegate>(obj0);
+    if (delegate == NULL)
+    {
+        PythonSupport::instance()->bufferRelease(&buffer);
+        return NULL;
+    }
+
+    QMap<QString, QVariant> imageMap = PyObjectToQVariant(obj1).toMap();
+
+    CommandsSharedPtr command_buffer(new std::vector<quint32>((quint32 *)buffer.buf, ((quint32 *)buffer.buf) + buffer.len / 4));
+
+    PythonSupport::instance()->bufferRelease(&buffer);
+
+    // decode v2 commands once here rather than each time the item is rasterized.
+    CommandsSharedPtr decoded_commands = DecodeBinaryCommands(command_buffer);
+    if (!decoded_commands)
+    {
+        PythonSupport::instance()->setErrorString("Invalid binary commands.");
+        return NULL;
+    }
+
+    delegate->setItemCommands(item_id, version, decoded_commands, imageMap);
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *TabWidget_addTab(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -5590,9 +6908,150 @@ static PyObject *TreeWidget_setSelectionMode(PyObject * /*self*/, PyObject *args
     if (!selection_modes.contains(selection_mode_c))
     return NULL;
 
-    py_tree_widget->setSelectionMode(static_cast<QAbstractItemView::SelectionMode>(selection_modes.indexOf(selection_mode_c)));
+    py_tree_widget->setSelectionMode(static_cast<QAbstractItemView::SelectionMode>(selection_modes.indexOf(selection_mode_c)));
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+/*
+ State of a widget between Widget_beginUpdate and Widget_endUpdate. Owned by the widget.
+
+ The layouts of the whole subtree are disabled so that changes to descendants do not lay them out either. Containers
+ whose forced layout was deferred are recorded and laid out when the transaction commits.
+ */
+class WidgetUpdateTransaction : public QObject
+{
+public:
+    WidgetUpdateTransaction(QWidget *widget)
+        : QObject(widget)
+        , widget(widget)
+        , depth(0)
+        , updates_enabled(widget->updatesEnabled())
+        , deferred_layouts(0)
+        , layout_requests(0)
+    {
+        transactions().insert(widget, this);
+        suspend(widget);
+        for (QWidget *child : widget->findChildren<QWidget *>())
+            suspend(child);
+        timer.start();
+    }
+
+    ~WidgetUpdateTransaction()
+    {
+        transactions().remove(widget);
+    }
+
+    virtual bool eventFilter(QObject * /*watched*/, QEvent *event) override
+    {
+        // the disabled layouts ignore these.
+        if (event->type() == QEvent::LayoutRequest)
+            layout_requests += 1;
+        return false;
+    }
+
+    // disable the layout of a widget in the subtree until the transaction commits.
+    void suspend(QWidget *subtree_widget)
+    {
+        // installing the filter again does not add it twice.
+        subtree_widget->installEventFilter(this);
+        QLayout *layout = subtree_widget->layout();
+        if (layout && layout->isEnabled())
+        {
+            layout->setEnabled(false);
+            disabled_layouts.append(layout);
+        }
+    }
+
+    // record a forced layout of the container, which may have been added to the subtree during the transaction.
+    void deferLayout(QWidget *container)
+    {
+        suspend(container);
+        deferred_layouts += 1;
+        if (!deferred_containers.contains(container))
+            deferred_containers.append(container);
+    }
+
+    /*
+     Re-enable the disabled layouts and lay out the deferred containers, most recently deferred first. Within an
+     enclosing transaction, which contains the whole subtree, both are passed to it instead.
+     */
+    void commit()
+    {
+        WidgetUpdateTransaction *outer_transaction = find(widget->parentWidget());
+
+        if (outer_transaction)
+        {
+            outer_transaction->disabled_layouts.append(disabled_layouts);
+            for (const QPointer<QWidget> &container : deferred_containers)
+            {
+                if (container && !outer_transaction->deferred_containers.contains(container))
+                    outer_transaction->deferred_containers.append(container);
+            }
+            return;
+        }
+
+        for (const QPointer<QLayout> &layout : disabled_layouts)
+        {
+            if (layout)
+                layout->setEnabled(true);
+        }
+
+        for (auto iter = deferred_containers.crbegin(); iter != deferred_containers.crend(); ++iter)
+        {
+            QWidget *container = *iter;
+            if (container && container->layout())
+                container->layout()->activate();
+        }
+
+        // the layouts ignored their layout requests while disabled. activating a layout that is not invalid does
+        // nothing. children are listed after their parents, so lay them out first.
+        for (auto iter = disabled_layouts.crbegin(); iter != disabled_layouts.crend(); ++iter)
+        {
+            QLayout *layout = *iter;
+            if (layout)
+                layout->activate();
+        }
+    }
+
+    // the innermost transaction containing the widget, if any.
+    static WidgetUpdateTransaction *find(QWidget *widget)
+    {
+        if (transactions().isEmpty())
+            return NULL;
+        for (; widget; widget = widget->parentWidget())
+        {
+            WidgetUpdateTransaction *transaction = transactions().value(widget);
+            if (transaction)
+                return transaction;
+        }
+        return NULL;
+    }
+
+    static QHash<QWidget *, WidgetUpdateTransaction *> &transactions()
+    {
+        static QHash<QWidget *, WidgetUpdateTransaction *> transactions;
+        return transactions;
+    }
+
+    QWidget *widget;
+    int depth;
+    bool updates_enabled;
+    int deferred_layouts;
+    int layout_requests;
+    QList<QPointer<QLayout>> disabled_layouts;
+    QList<QPointer<QWidget>> deferred_containers;
+    QElapsedTimer timer;
+};
 
-    return PythonSupport::instance()->getNoneReturnValue();
+// force the container layout to re-layout unless the container is within an update transaction.
+static void Widget_forceLayout(QWidget *container)
+{
+    WidgetUpdateTransaction *transaction = WidgetUpdateTransaction::find(container);
+    if (transaction)
+        transaction->deferLayout(container);
+    else
+        container->layout()->setGeometry(container->layout()->geometry());
 }
 
 static PyObject *Widget_addOverlay(PyObject * /*self*/, PyObject *args)
@@ -5702,7 +7161,7 @@ static PyObject *Widget_addWidget(PyObject * /*self*/, PyObject *args)
     {
         container->layout()->addWidget(widget);
         // now force the layout to re-layout
-        container->layout()->setGeometry(container->layout()->geometry());
+        Widget_forceLayout(container);
     }
 
     return PythonSupport::instance()->getNoneReturnValue();
@@ -5731,6 +7190,222 @@ static PyObject *Widget_adjustSize(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+/*
+ Begin an update transaction on the widget. Updates of the widget and the layouts of its subtree are disabled and
+ forced layouts within it are deferred until the matching Widget_endUpdate. Transactions may be nested.
+ */
+static PyObject *Widget_beginUpdate(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    if (!PythonSupport::instance()->parse()(args, "O", &obj0))
+        return NULL;
+
+    // Grab the widget
+    QWidget *widget = Unwrap<QWidget>(obj0);
+    if (widget == NULL)
+        return NULL;
+
+    WidgetUpdateTransaction *transaction = WidgetUpdateTransaction::transactions().value(widget);
+
+    if (!transaction)
+    {
+        transaction = new WidgetUpdateTransaction(widget);
+        widget->setUpdatesEnabled(false);
+    }
+
+    transaction->depth += 1;
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
+template <typename T>
+static bool Widget_connectPyObject_(QWidget *widget, const QVariant &py_object)
+{
+    T *t = dynamic_cast<T *>(widget);
+    if (t)
+        t->setPyObject(py_object);
+    return t != NULL;
+}
+
+// connect the callback object of an intrinsic widget, like the type specific connect functions.
+static bool Widget_connectPyObject(QWidget *widget, const QVariant &py_object)
+{
+    return Widget_connectPyObject_<PyCanvas>(widget, py_object)
+        || Widget_connectPyObject_<PyCheckBox>(widget, py_object)
+        || Widget_connectPyObject_<PyComboBox>(widget, py_object)
+        || Widget_connectPyObject_<PyLineEdit>(widget, py_object)
+        || Widget_connectPyObject_<PyPushButton>(widget, py_object)
+        || Widget_connectPyObject_<PyRadioButton>(widget, py_object)
+        || Widget_connectPyObject_<PyScrollArea>(widget, py_object)
+        || Widget_connectPyObject_<PySlider>(widget, py_object)
+        || Widget_connectPyObject_<PyTabWidget>(widget, py_object)
+        || Widget_connectPyObject_<PyTextBrowser>(widget, py_object)
+        || Widget_connectPyObject_<PyTextEdit>(widget, py_object);
+}
+
+// add the child to the container without forcing a layout.
+static bool Widget_addChild(QWidget *container, QWidget *child, const QVariantMap &description)
+{
+    if (dynamic_cast<QSplitter *>(container) != NULL)
+    {
+        dynamic_cast<QSplitter *>(container)->addWidget(child);
+    }
+    else if (dynamic_cast<QStackedWidget *>(container) != NULL)
+    {
+        dynamic_cast<QStackedWidget *>(container)->addWidget(child);
+    }
+    else if (dynamic_cast<PyTabWidget *>(container) != NULL)
+    {
+        dynamic_cast<PyTabWidget *>(container)->addTab(child, description.value("label").toString());
+    }
+    else if (dynamic_cast<QScrollArea *>(container) != NULL)
+    {
+        dynamic_cast<QScrollArea *>(container)->setWidget(child);
+    }
+    else if (dynamic_cast<QBoxLayout *>(container->layout()) != NULL)
+    {
+        QByteArray alignment = description.value("alignment").toString().toUtf8();
+        int stretch = description.value("stretch").toInt();
+        dynamic_cast<QBoxLayout *>(container->layout())->addWidget(child, stretch, ParseAlignment(alignment.isEmpty() ? NULL : alignment.constData()));
+        if (description.value("fill").toBool())
+            child->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ Build the widget described by the description and its children, appending each widget to widgets in depth first
+ order. Returns NULL with error set on failure after deleting anything built so far.
+ */
+static QWidget *Widget_buildTree_(const QVariantMap &description, QVariantList &widgets, QString &error)
+{
+    QString type = description.value("type").toString();
+
+    QWidget *widget = Widget_makeIntrinsicWidget(type);
+    if (widget == NULL)
+    {
+        error = QString("Unknown widget type '%1'.").arg(type);
+        return NULL;
+    }
+
+    widgets.append(QVariant::fromValue((QObject *)widget));
+
+    QVariantMap properties = description.value("properties").toMap();
+    for (auto iter = properties.constBegin(); iter != properties.constEnd(); ++iter)
+        Widget_setWidgetProperty_(widget, iter.key(), iter.value());
+
+    if (description.contains("callback") && !Widget_connectPyObject(widget, description.value("callback")))
+    {
+        error = QString("Widget type '%1' does not accept a callback.").arg(type);
+        delete widget;
+        return NULL;
+    }
+
+    for (const auto &child_variant : description.value("children").toList())
+    {
+        QVariantMap child_description = child_variant.toMap();
+
+        QWidget *child = Widget_buildTree_(child_description, widgets, error);
+        if (child == NULL)
+        {
+            delete widget;
+            return NULL;
+        }
+
+        if (!Widget_addChild(widget, child, child_description))
+        {
+            error = QString("Widget type '%1' does not accept children.").arg(type);
+            delete child;
+            delete widget;
+            return NULL;
+        }
+    }
+
+    return widget;
+}
+
+/*
+ Build a widget tree from a nested description in one call.
+
+ Each description is a dict with an intrinsic widget "type" and optional "properties" dict, "callback" object, and
+ "children" list. Children may also specify "label" (tabs), "stretch", "fill", and "alignment" (rows and columns),
+ as may the root when the container is a row or column. The tree is built unparented so no layout happens until it
+ is optionally added to the container at index, which forces a single layout. Returns the widgets in depth first
+ order, starting with the root.
+ */
+static PyObject *Widget_buildTree(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    PyObject *obj1 = NULL;
+    int index = -1;
+    if (!PythonSupport::instance()->parse()(args, "O|Oi", &obj0, &obj1, &index))
+        return NULL;
+
+    QWidget *container = NULL;
+    if (obj1 != NULL && !PythonSupport::instance()->isNone(obj1))
+    {
+        container = Unwrap<QWidget>(obj1);
+        if (container == NULL)
+            return NULL;
+    }
+
+    QVariantMap description = PyObjectToQVariant(obj0).toMap();
+
+    QVariantList widgets;
+    QString error;
+
+    QWidget *root = Widget_buildTree_(description, widgets, error);
+    if (root == NULL)
+    {
+        PythonSupport::instance()->setErrorString(error.toStdString());
+        return NULL;
+    }
+
+    if (container != NULL)
+    {
+        if (dynamic_cast<QSplitter *>(container) != NULL)
+        {
+            dynamic_cast<QSplitter *>(container)->insertWidget(index, root);
+        }
+        else
+        {
+            QBoxLayout *box_layout = dynamic_cast<QBoxLayout *>(container->layout());
+            if (!box_layout)
+            {
+                delete root;
+                PythonSupport::instance()->setErrorString("Container does not accept children.");
+                return NULL;
+            }
+            QByteArray alignment = description.value("alignment").toString().toUtf8();
+            int stretch = description.value("stretch").toInt();
+            box_layout->insertWidget(index, root, stretch, ParseAlignment(alignment.isEmpty() ? NULL : alignment.constData()));
+            if (description.value("fill").toBool())
+                root->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+            // now force the layout to re-layout
+            Widget_forceLayout(container);
+        }
+    }
+
+    return QVariantToPyObject(widgets);
+}
+
 static PyObject *Widget_clearFocus(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -5753,6 +7428,60 @@ static PyObject *Widget_clearFocus(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+/*
+ End an update transaction on the widget. Ending the outermost transaction restores the layouts and updates, lays out
+ each container whose forced layout was deferred, and repaints once. Returns a dict with the number of forced layouts
+ deferred ("deferred_layouts"), the layout requests ignored within the subtree ("layout_requests"), the transaction
+ duration ("duration_ms"), and whether this ended the outermost transaction ("committed").
+ */
+static PyObject *Widget_endUpdate(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    if (!PythonSupport::instance()->parse()(args, "O", &obj0))
+        return NULL;
+
+    // Grab the widget
+    QWidget *widget = Unwrap<QWidget>(obj0);
+    if (widget == NULL)
+        return NULL;
+
+    WidgetUpdateTransaction *transaction = WidgetUpdateTransaction::transactions().value(widget);
+
+    if (!transaction)
+    {
+        PythonSupport::instance()->setErrorString("Widget is not in an update transaction.");
+        return NULL;
+    }
+
+    transaction->depth -= 1;
+
+    QVariantMap result;
+    result["deferred_layouts"] = transaction->deferred_layouts;
+    result["layout_requests"] = transaction->layout_requests;
+    result["duration_ms"] = transaction->timer.elapsed();
+    result["committed"] = transaction->depth == 0;
+
+    if (transaction->depth == 0)
+    {
+        bool updates_enabled = transaction->updates_enabled;
+
+        transaction->commit();
+
+        delete transaction;
+
+        // enabling updates also schedules the repaint.
+        widget->setUpdatesEnabled(updates_enabled);
+    }
+
+    return QVariantToPyObject(result);
+}
+
 static PyObject *Widget_hide(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -5775,6 +7504,51 @@ static PyObject *Widget_hide(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+// return the event coalescer of widgets that coalesce events, or NULL.
+static EventCoalescer *GetEventCoalescer(QWidget *widget)
+{
+    PyCanvas *canvas = dynamic_cast<PyCanvas *>(widget);
+    if (canvas)
+        return &canvas->eventCoalescer();
+
+    PyScrollArea *scroll_area = dynamic_cast<PyScrollArea *>(widget);
+    if (scroll_area)
+        return &scroll_area->eventCoalescer();
+
+    return NULL;
+}
+
+static PyObject *Widget_getEventCoalescingStatistics(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "O", &obj0))
+        return NULL;
+
+    QWidget *widget = Unwrap<QWidget>(obj0);
+    if (widget == NULL)
+        return NULL;
+
+    EventCoalescer *event_coalescer = GetEventCoalescer(widget);
+    if (event_coalescer == NULL)
+    {
+        PythonSupport::instance()->setErrorString("Widget does not coalesce events.");
+        return NULL;
+    }
+
+    QVariantMap statistics;
+
+    event_coalescer->getStatistics(statistics);
+
+    return QVariantToPyObject(statistics);
+}
+
 static PyObject *Widget_getFocusPolicy(PyObject * /*self*/, PyObject *args)
 {
     PyObject *obj0 = NULL;
@@ -5933,7 +7707,7 @@ static PyObject *Widget_insertWidget(PyObject * /*self*/, PyObject *args)
         widget->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
     // now force the layout to re-layout
-    container->layout()->setGeometry(container->layout()->geometry());
+    Widget_forceLayout(container);
 
     return PythonSupport::instance()->getNoneReturnValue();
 }
@@ -6060,7 +7834,7 @@ static PyObject *Widget_removeWidget(PyObject * /*self*/, PyObject *args)
     // has been deleted.
 
     {
-        Python_ThreadAllow thread_allow;
+        Python_ThreadAllow thread_allow(__func__);
         
         delete widget;
     }
@@ -6129,6 +7903,48 @@ static PyObject *Widget_setEnabled(PyObject * /*self*/, PyObject *args)
     return PythonSupport::instance()->getNoneReturnValue();
 }
 
+static PyObject *Widget_setEventCoalescing(PyObject * /*self*/, PyObject *args)
+{
+    if (qApp->thread() != QThread::currentThread())
+    {
+        PythonSupport::instance()->setErrorString("Must be called on UI thread.");
+        return NULL;
+    }
+
+    PyObject *obj0 = NULL;
+    char *policy_c = NULL;
+
+    if (!PythonSupport::instance()->parse()(args, "Os", &obj0, &policy_c))
+        return NULL;
+
+    QWidget *widget = Unwrap<QWidget>(obj0);
+    if (widget == NULL)
+        return NULL;
+
+    EventCoalescer *event_coalescer = GetEventCoalescer(widget);
+    if (event_coalescer == NULL)
+    {
+        PythonSupport::instance()->setErrorString("Widget does not coalesce events.");
+        return NULL;
+    }
+
+    QString policy(policy_c);
+
+    if (policy == "immediate")
+        event_coalescer->setPolicy(EventCoalescer::Immediate);
+    else if (policy == "coalesced")
+        event_coalescer->setPolicy(EventCoalescer::Coalesced);
+    else if (policy == "batched")
+        event_coalescer->setPolicy(EventCoalescer::Batched);
+    else
+    {
+        PythonSupport::instance()->setErrorString("Unknown event coalescing policy.");
+        return NULL;
+    }
+
+    return PythonSupport::instance()->getNoneReturnValue();
+}
+
 static PyObject *Widget_setFocus(PyObject * /*self*/, PyObject *args)
 {
     if (qApp->thread() != QThread::currentThread())
@@ -6406,8 +8222,66 @@ void Application::output(const QString &str)
         qDebug() << str.trimmed().toUtf8().constData();
 }
 
+// return the duration in microseconds below which the fraction of the histogram durations fall.
+static qint64 GILHistogramPercentileUs(const GILDurationHistogram &histogram, double fraction)
+{
+    uint64_t threshold = static_cast<uint64_t>(histogram.count * fraction);
+    uint64_t count = 0;
+    for (int i = 0; i < static_cast<int>(histogram.buckets.size()); ++i)
+    {
+        count += histogram.buckets[i];
+        if (count > threshold)
+            return qint64(1) << i;
+    }
+    return static_cast<qint64>(histogram.max_ns / 1000);
+}
+
+// log the GIL statistics per call site since the last log, slowest waits first.
+void Application::logGILStatistics()
+{
+    std::map<std::string, GILCallSiteStatistics> statistics;
+    GetGILStatistics(statistics, true);
+
+    QList<QPair<std::string, GILCallSiteStatistics>> call_sites;
+    for (const auto &entry : statistics)
+    {
+        if (entry.second.wait.count > 0 || entry.second.hold.count > 0)
+            call_sites.append(qMakePair(entry.first, entry.second));
+    }
+
+    std::sort(call_sites.begin(), call_sites.end(), [](const auto &a, const auto &b) { return a.second.wait.max_ns > b.second.wait.max_ns; });
+
+    for (const auto &call_site : call_sites)
+    {
+        const GILDurationHistogram &wait = call_site.second.wait;
+        const GILDurationHistogram &hold = call_site.second.hold;
+        qDebug().nospace() << "GIL " << call_site.first.c_str()
+            << " wait n=" << wait.count << " mean=" << (wait.count > 0 ? wait.total_ns / wait.count / 1000 : 0) << "us p99<" << GILHistogramPercentileUs(wait, 0.99) << "us max=" << wait.max_ns / 1000 << "us"
+            << " hold n=" << hold.count << " mean=" << (hold.count > 0 ? hold.total_ns / hold.count / 1000 : 0) << "us p99<" << GILHistogramPercentileUs(hold, 0.99) << "us max=" << hold.max_ns / 1000 << "us";
+    }
+}
+
+// log the GIL statistics periodically while instrumentation is enabled. pass 0 to stop logging.
+void Application::setGILStatisticsLogInterval(int interval_ms)
+{
+    if (interval_ms > 0)
+    {
+        if (!m_gil_statistics_log_timer)
+        {
+            m_gil_statistics_log_timer = new QTimer(this);
+            connect(m_gil_statistics_log_timer, SIGNAL(timeout()), this, SLOT(logGILStatistics()));
+        }
+        m_gil_statistics_log_timer->start(interval_ms);
+    }
+    else if (m_gil_statistics_log_timer)
+    {
+        m_gil_statistics_log_timer->stop();
+    }
+}
+
 Application::Application(int & argv, char **args)
     : QApplication(argv, args)
+    , m_gil_statistics_log_timer(nullptr)
 {
 #if defined(Q_OS_WIN)
     // use old style until Qt has sensible text field defaults
@@ -6483,13 +8357,26 @@ static PyMethodDef Methods[] = {
     {"ButtonGroup_removeButton", ButtonGroup_removeButton, METH_VARARGS, "ButtonGroup_removeButton."},
 
     {"Canvas_connect", Canvas_connect, METH_VARARGS, "Canvas_connect."},
+    {"Canvas_defineDisplayList", Canvas_defineDisplayList, METH_VARARGS, "Canvas_defineDisplayList."},
     {"Canvas_draw", Canvas_draw, METH_VARARGS, "Canvas_draw."},
     {"Canvas_draw_binary", Canvas_draw_binary, METH_VARARGS, "Canvas_draw."},
     {"Canvas_drawSection_binary", Canvas_drawSection_binary, METH_VARARGS, "Canvas_draw_section."},
+    {"Canvas_getDataProbe", Canvas_getDataProbe, METH_VARARGS, "Canvas_getDataProbe."},
+    {"Canvas_getRenderStatistics", Canvas_getRenderStatistics, METH_VARARGS, "Canvas_getRenderStatistics."},
     {"Canvas_grabMouse", Canvas_grabMouse, METH_VARARGS, "Canvas_grabMouse."},
+    {"Canvas_hitTest", Canvas_hitTest, METH_VARARGS, "Canvas_hitTest."},
+    {"Canvas_patchSection_binary", Canvas_patchSection_binary, METH_VARARGS, "Canvas_patchSection_binary."},
     {"Canvas_releaseMouse", Canvas_releaseMouse, METH_VARARGS, "Canvas_releaseMouse."},
+    {"Canvas_removeDisplayList", Canvas_removeDisplayList, METH_VARARGS, "Canvas_removeDisplayList."},
     {"Canvas_removeSection", Canvas_removeSection, METH_VARARGS, "Canvas_removeSection."},
+    {"Canvas_setCrosshair", Canvas_setCrosshair, METH_VARARGS, "Canvas_setCrosshair."},
     {"Canvas_setCursorShape", Canvas_setCursorShape, METH_VARARGS, "Canvas_setCursorShape."},
+    {"Canvas_setDataReadout", Canvas_setDataReadout, METH_VARARGS, "Canvas_setDataReadout."},
+    {"Canvas_setOverlay_binary", Canvas_setOverlay_binary, METH_VARARGS, "Canvas_setOverlay_binary."},
+    {"Canvas_setSectionProgressive", Canvas_setSectionProgressive, METH_VARARGS, "Canvas_setSectionProgressive."},
+    {"Canvas_setSectionRenderMode", Canvas_setSectionRenderMode, METH_VARARGS, "Canvas_setSectionRenderMode."},
+    {"Canvas_setSectionStrokeSimplification", Canvas_setSectionStrokeSimplification, METH_VARARGS, "Canvas_setSectionStrokeSimplification."},
+    {"Canvas_setSectionTransform", Canvas_setSectionTransform, METH_VARARGS, "Canvas_setSectionTransform."},
 
     {"CheckBox_connect", CheckBox_connect, METH_VARARGS, "CheckBox_connect."},
     {"CheckBox_getCheckState", CheckBox_getCheckState, METH_VARARGS, "CheckBox_getCheckState."},
@@ -6511,13 +8398,17 @@ static PyMethodDef Methods[] = {
     {"ComboBox_removeAllItems", ComboBox_removeAllItems, METH_VARARGS, "ComboBox_removeAllItems."},
     {"ComboBox_setCurrentText", ComboBox_setCurrentText, METH_VARARGS, "ComboBox_setCurrentText."},
 
+    {"Core_benchmarkConversion", Core_benchmarkConversion, METH_VARARGS, "Core_benchmarkConversion."},
     {"Core_getFontMetrics", Core_getFontMetrics, METH_VARARGS, "Core_getFontMetrics."},
+    {"Core_getGILStatistics", Core_getGILStatistics, METH_VARARGS, "Core_getGILStatistics."},
     {"Core_getLocation", Core_getLocation, METH_VARARGS, "Core_getLocation."},
     {"Core_getQtVersion", Core_getQtVersion, METH_VARARGS, "Core_getQtVersion."},
     {"Core_getBuildVersion", Core_getBuildVersion, METH_VARARGS, "Core_getBuildVersion."},
     {"Core_out", Core_out, METH_VARARGS, "Core_out."},
     {"Core_pathToURL", Core_pathToURL, METH_VARARGS, "Core_pathToURL."},
+    {"Core_runNativeTests", Core_runNativeTests, METH_VARARGS, "Core_runNativeTests."},
     {"Core_setApplicationInfo", Core_setApplicationInfo, METH_VARARGS, "Core_setApplicationInfo."},
+    {"Core_setGILInstrumentation", Core_setGILInstrumentation, METH_VARARGS, "Core_setGILInstrumentation."},
     {"Core_syncLatencyTimer", Core_syncLatencyTimer, METH_VARARGS, "Core_syncLatencyTimer"},
     {"Core_truncateToWidth", Core_truncateToWidth, METH_VARARGS, "Core_truncateToWidth."},
     {"Core_URLToPath", Core_URLToPath, METH_VARARGS, "Core_URLToPath."},
@@ -6556,7 +8447,9 @@ static PyMethodDef Methods[] = {
     {"Drag_exec", Drag_exec, METH_VARARGS, "Drag_exec."},
     {"Drag_setThumbnail", Drag_setThumbnail, METH_VARARGS, "Drag_setThumbnail."},
 
+    {"DrawingContext_benchmarkBinary", DrawingContext_benchmarkBinary, METH_VARARGS, "DrawingContext_benchmarkBinary."},
     {"DrawingContext_drawCommands", DrawingContext_drawCommands, METH_VARARGS, "DrawingContext_drawCommands."},
+    {"DrawingContext_encodeBinary_v2", DrawingContext_encodeBinary_v2, METH_VARARGS, "DrawingContext_encodeBinary_v2."},
     {"DrawingContext_paintRGBAToImage", DrawingContext_paintRGBAToImage, METH_VARARGS, "DrawingContext_paintRGBA."},
     {"DrawingContext_paintRGBAToImage_binary", DrawingContext_paintRGBAToImage_binary, METH_VARARGS, "DrawingContext_paintRGBA_binary."},
 
@@ -6570,6 +8463,7 @@ static PyMethodDef Methods[] = {
     {"ItemModel_destroy", ItemModel_destroy, METH_VARARGS, "ItemModel destroy."},
     {"ItemModel_endInsertRow", ItemModel_endInsertRow, METH_VARARGS, "ItemModel endInsertRows."},
     {"ItemModel_endRemoveRow", ItemModel_endRemoveRow, METH_VARARGS, "ItemModel endRemoveRows."},
+    {"ItemModel_setRows", ItemModel_setRows, METH_VARARGS, "ItemModel_setRows."},
 
     {"Label_setTextAlignmentHorizontal", Label_setTextAlignmentHorizontal, METH_VARARGS, "Label_setTextAlignmentHorizontal."},
     {"Label_setTextAlignmentVertical", Label_setTextAlignmentVertical, METH_VARARGS, "Label_setTextAlignmentVertical."},
@@ -6643,8 +8537,10 @@ static PyMethodDef Methods[] = {
     {"StackWidget_removeWidget", StackWidget_removeWidget, METH_VARARGS, "StackWidget_removeWidget"},
     {"StackWidget_setCurrentIndex", StackWidget_setCurrentIndex, METH_VARARGS, "StackWidget_setCurrentIndex"},
 
+    {"StyledDelegate_clearItemCommands", StyledDelegate_clearItemCommands, METH_VARARGS, "StyledDelegate_clearItemCommands."},
     {"StyledDelegate_connect", StyledDelegate_connect, METH_VARARGS, "StyledDelegate_connect."},
     {"StyledDelegate_create", StyledDelegate_create, METH_VARARGS, "StyledDelegate_create."},
+    {"StyledDelegate_setItemCommands_binary", StyledDelegate_setItemCommands_binary, METH_VARARGS, "StyledDelegate_setItemCommands_binary."},
 
     {"TabWidget_addTab", TabWidget_addTab, METH_VARARGS, "TabWidget_addTab."},
     {"TabWidget_connect", TabWidget_connect, METH_VARARGS, "TabWidget_connect."},
@@ -6696,7 +8592,11 @@ static PyMethodDef Methods[] = {
     {"Widget_addStretch", Widget_addStretch, METH_VARARGS, "Widget_addStretch."},
     {"Widget_addWidget", Widget_addWidget, METH_VARARGS, "Widget_addWidget."},
     {"Widget_adjustSize", Widget_adjustSize, METH_VARARGS, "Widget_adjustSize."},
+    {"Widget_beginUpdate", Widget_beginUpdate, METH_VARARGS, "Widget_beginUpdate."},
+    {"Widget_buildTree", Widget_buildTree, METH_VARARGS, "Widget_buildTree."},
     {"Widget_clearFocus", Widget_clearFocus, METH_VARARGS, "Widget_clearFocus."},
+    {"Widget_endUpdate", Widget_endUpdate, METH_VARARGS, "Widget_endUpdate."},
+    {"Widget_getEventCoalescingStatistics", Widget_getEventCoalescingStatistics, METH_VARARGS, "Widget_getEventCoalescingStatistics."},
     {"Widget_getFocusPolicy", Widget_getFocusPolicy , METH_VARARGS, "Widget_getFocusPolicy."},
     {"Widget_getWidgetProperty", Widget_getWidgetProperty, METH_VARARGS, "Widget_getWidgetProperty."},
     {"Widget_getWidgetSize", Widget_getWidgetSize, METH_VARARGS, "Widget_getWidgetSize."},
@@ -6712,6 +8612,7 @@ static PyMethodDef Methods[] = {
     {"Widget_removeWidget", Widget_removeWidget, METH_VARARGS, "Widget_removeWidget."},
     {"Widget_setAttributes", Widget_setAttributes, METH_VARARGS, "Widget_setAttributes."},
     {"Widget_setEnabled", Widget_setEnabled, METH_VARARGS, "Widget_setEnabled."},
+    {"Widget_setEventCoalescing", Widget_setEventCoalescing, METH_VARARGS, "Widget_setEventCoalescing."},
     {"Widget_setFocus", Widget_setFocus, METH_VARARGS, "Widget_setFocus."},
     {"Widget_setFocusPolicy", Widget_setFocusPolicy, METH_VARARGS, "Widget_setFocusPolicy."},
     {"Widget_setPaletteColor", Widget_setPaletteColor, METH_VARARGS, "Widget_setPaletteColor."},
@@ -6937,7 +8838,7 @@ bool Application::initialize()
         QString bootstrap_error;
 
         {
-            Python_ThreadBlock thread_block;
+            Python_ThreadBlock thread_block(__func__);
 
             // Add the resources path so that the Python imports work. This is necessary to find bootstrap.py,
             // which may not be in the same directory as the executable (specifically for Mac OS where things
@@ -7004,12 +8905,18 @@ QString Application::resourcesPath() const
 
 QVariant Application::invokePyMethod(PyObjectPtr *object, const QString &method, const QVariantList &qargs)
 {
-    std::list<PythonValueVariant> args;
-    Q_FOREACH(const QVariant &variant, qargs)
-    {
-        args.push_back(QVariantToPythonValueVariant(variant));
-    }
-    return PythonValueVariantToQVariant(PythonSupport::instance()->invokePyMethod(object, method.toStdString(), args));
+    Python_ThreadBlock thread_block(__func__);
+
+    PythonSupport *python_support = PythonSupport::instance();
+
+    PyObjectPtr py_args(qargs.size() > 0 ? python_support->newTuple(qargs.size()) : NULL);
+
+    for (int i = 0; i < qargs.size(); ++i)
+        python_support->tupleSetItem(py_args, i, QVariantToPyObject(qargs.at(i)));
+
+    PyObjectPtr py_result(python_support->callPyMethod(object, method.toStdString(), py_args));
+
+    return py_result ? PyObjectToQVariant(py_result) : QVariant();
 }
 
 bool Application::setPyObjectAttribute(PyObjectPtr *object, const QString &attribute, const QVariant &value)
@@ -7024,7 +8931,31 @@ QVariant Application::getPyObjectAttribute(PyObjectPtr *object, const QString &a
 
 QVariant Application::dispatchPyMethod(const QVariant &object, const QString &method, const QVariantList &args)
 {
-    return invokePyMethod(m_bootstrap_module.get(), "bootstrap_dispatch", QVariantList() << object << method << QVariant(args));
+    // objects other than Python objects are passed to bootstrap_dispatch, which reports the error.
+    if (object.userType() != PyObjectPtr_metaId() || !static_cast<const PyObjectPtr *>(object.constData())->isValid())
+        return invokePyMethod(m_bootstrap_module.get(), "bootstrap_dispatch", QVariantList() << object << method << QVariant(args));
+
+    Python_ThreadBlock thread_block(__func__);
+
+    // the first item is reserved for the object.
+    std::vector<PyObject *> py_args;
+    py_args.reserve(args.size() + 1);
+    py_args.push_back(NULL);
+
+    for (const auto &arg : args)
+        py_args.push_back(QVariantToPyObject(arg));
+
+    PyObject *py_object = static_cast<const PyObjectPtr *>(object.constData())->get();
+
+    PyObjectPtr py_result(PythonSupport::instance()->dispatchPyMethod(py_object, method.toStdString(), py_args));
+
+    return py_result ? PyObjectToQVariant(py_result) : QVariant();
+}
+
+// dispatch a list of (object, method, args) records in a single call, holding the GIL once.
+void Application::dispatchPyMethodBatch(const QVariantList &records)
+{
+    invokePyMethod(m_bootstrap_module.get(), "bootstrap_dispatch_batch", QVariantList() << QVariant(records));
 }
 
 void Application::closeSplashScreen()
@@ -16,6 +16,7 @@ float GetDisplayScaling();
 
 class DocumentWindow;
 class PyObjectPtr;
+class QTimer;
 
 typedef QList<DocumentWindow *> DocumentWindowList;
 
@@ -38,16 +39,19 @@ public:
     // Python related methods
     QVariant invokePyMethod(PyObjectPtr *object, const QString &method, const QVariantList &args);
     QVariant dispatchPyMethod(const QVariant &object, const QString &method, const QVariantList &args);
+    void dispatchPyMethodBatch(const QVariantList &records);
     bool setPyObjectAttribute(PyObjectPtr *object, const QString &attribute, const QVariant &value);
     QVariant getPyObjectAttribute(PyObjectPtr *object, const QString &attribute);
     void closeSplashScreen();
     QFile &getLogFile() { return logFile; }
+    void setGILStatisticsLogInterval(int interval_ms);
 
 public Q_SLOTS:
     void output(const QString &str);
 
 private Q_SLOTS:
     void aboutToQuit();
+    void logGILStatistics();
 
 private:
     QScopedPointer<QSplashScreen> m_splash_screen;
@@ -62,6 +66,8 @@ private:
     std::unique_ptr<PyObjectPtr> m_bootstrap_module;
     std::unique_ptr<PyObjectPtr> m_py_application;
 
+    QTimer *m_gil_statistics_log_timer;
+
     friend class DocumentWindow;
 };
 
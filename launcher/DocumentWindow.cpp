@@ -19,6 +19,7 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QtEndian>
 #include <QtCore/QMimeData>
 #include <QtCore/QQueue>
 #include <QtCore/QRegularExpression>
@@ -27,7 +28,9 @@
 #include <QtCore/QThread>
 #include <QtCore/QThreadPool>
 #include <QtCore/QTimer>
+#include <QtCore/QtMath>
 #include <QtCore/QUrl>
+#include <QtCore/qfloat16.h>
 
 #include <QtGui/QAction>
 #include <QtGui/QFontDatabase>
@@ -70,6 +73,7 @@ Q_DECLARE_METATYPE(std::string)
 
 // from application
 PyObject *QVariantToPyObject(const QVariant &value);
+int PyObjectPtr_metaId();
 
 const auto DEFAULT_RENDER_HINTS = QPainter::Antialiasing | QPainter::TextAntialiasing;
 
@@ -151,6 +155,7 @@ RepaintManager repaintManager;
 DocumentWindow::DocumentWindow(const QString &title, QWidget *parent)
     : QMainWindow(parent)
     , m_closed(false)
+    , m_event_batch_scheduled(false)
 {
     setAttribute(Qt::WA_DeleteOnClose, true);
 
@@ -197,6 +202,40 @@ void DocumentWindow::timerEvent(QTimerEvent *event)
     }
 }
 
+// queue the pending events of the event coalescer to be dispatched with those of other widgets in a single call.
+void DocumentWindow::queueEventBatch(QWidget *widget, EventCoalescer *event_coalescer)
+{
+    m_event_batch.append(qMakePair(QPointer<QWidget>(widget), event_coalescer));
+
+    if (!m_event_batch_scheduled)
+    {
+        m_event_batch_scheduled = true;
+        QTimer::singleShot(0, this, [this]() { dispatchEventBatch(); });
+    }
+}
+
+// dispatch the pending events of all queued event coalescers as a list of (object, method, args) records.
+void DocumentWindow::dispatchEventBatch()
+{
+    m_event_batch_scheduled = false;
+
+    // take the batch since dispatching may queue new events.
+    QList<QPair<QPointer<QWidget>, EventCoalescer *>> event_batch;
+    event_batch.swap(m_event_batch);
+
+    QVariantList records;
+
+    for (const auto &entry : event_batch)
+    {
+        // skip event coalescers of widgets deleted since queueing.
+        if (entry.first)
+            entry.second->takePendingEvents(records);
+    }
+
+    if (!records.isEmpty())
+        application()->dispatchPyMethodBatch(records);
+}
+
 void DocumentWindow::hideEvent(QHideEvent *hide_event)
 {
     if (this->windowHandle())
@@ -990,7 +1029,210 @@ void Overlay::resizeEvent(QResizeEvent *event)
     QWidget::resizeEvent(event);
 }
 
+EventCoalescer::EventCoalescer(QWidget *widget, const QVariant &py_object)
+    : m_widget(widget)
+    , m_py_object(py_object)
+    , m_policy(Immediate)
+    , m_flush_scheduled(false)
+    , m_queued_count(0)
+    , m_merged_count(0)
+    , m_dispatched_count(0)
+    , m_batched_count(0)
+{
+}
+
+void EventCoalescer::setPolicy(Policy policy)
+{
+    // dispatch events pending under the previous policy.
+    flush();
+
+    m_policy = policy;
+}
+
+// dispatch the event after the pending events, or append it to the batch with the batched policy.
+void EventCoalescer::post(const QString &method, const QVariantList &args)
+{
+    m_queued_count += 1;
+
+    if (m_policy == Batched && documentWindow())
+    {
+        m_pending_events.append(PendingEvent{method, args});
+        scheduleFlush();
+    }
+    else
+    {
+        flush();
+        dispatch(method, args);
+    }
+}
+
+// queue the event, replacing the arguments of a pending event with the same method.
+void EventCoalescer::queue(const QString &method, const QVariantList &args)
+{
+    m_queued_count += 1;
+
+    if (m_policy == Immediate)
+    {
+        dispatch(method, args);
+        return;
+    }
+
+    PendingEvent *pending_event = findPendingEvent(method);
+
+    if (pending_event)
+    {
+        pending_event->args = args;
+        m_merged_count += 1;
+    }
+    else
+    {
+        m_pending_events.append(PendingEvent{method, args});
+        scheduleFlush();
+    }
+}
+
+/*
+ Queue the event, adding the integer arguments in the delta range to those of a pending event with the same method.
+
+ Arguments before the delta range replace those of the pending event. Arguments after the delta range qualify the
+ deltas (such as modifiers or orientation); if they differ from those of the pending event, the pending events are
+ dispatched first.
+ */
+void EventCoalescer::accumulate(const QString &method, const QVariantList &args, int delta_index, int delta_count)
+{
+    m_queued_count += 1;
+
+    if (m_policy == Immediate)
+    {
+        dispatch(method, args);
+        return;
+    }
+
+    PendingEvent *pending_event = findPendingEvent(method);
+
+    if (pending_event && pending_event->args.mid(delta_index + delta_count) != args.mid(delta_index + delta_count))
+    {
+        flush();
+        pending_event = nullptr;
+    }
+
+    if (pending_event)
+    {
+        QVariantList merged_args = args;
+        for (int i = delta_index; i < delta_index + delta_count; ++i)
+            merged_args[i] = pending_event->args[i].toInt() + args[i].toInt();
+        pending_event->args = merged_args;
+        m_merged_count += 1;
+    }
+    else
+    {
+        m_pending_events.append(PendingEvent{method, args});
+        scheduleFlush();
+    }
+}
+
+// dispatch the pending events now. with the batched policy, this dispatches the whole batch of the window.
+void EventCoalescer::flush()
+{
+    DocumentWindow *document_window = m_policy == Batched ? documentWindow() : nullptr;
+
+    if (document_window)
+    {
+        document_window->dispatchEventBatch();
+        return;
+    }
+
+    // a flush timer still pending finds nothing to do, so allow a new one, or a batch after a change of policy.
+    m_flush_scheduled = false;
+
+    // take the pending events since dispatching may queue new events.
+    QList<PendingEvent> pending_events;
+    pending_events.swap(m_pending_events);
+
+    for (const auto &pending_event : pending_events)
+        dispatch(pending_event.method, pending_event.args);
+}
+
+// append the pending events as (object, method, args) records.
+void EventCoalescer::takePendingEvents(QVariantList &records)
+{
+    m_flush_scheduled = false;
+
+    QList<PendingEvent> pending_events;
+    pending_events.swap(m_pending_events);
+
+    // events pending when the Python object is released are dropped.
+    if (!m_py_object.isValid())
+        return;
+
+    for (const auto &pending_event : pending_events)
+        records.append(QVariant(QVariantList() << m_py_object << pending_event.method << QVariant(pending_event.args)));
+
+    m_batched_count += pending_events.size();
+    m_dispatched_count += pending_events.size();
+}
+
+void EventCoalescer::getStatistics(QVariantMap &statistics) const
+{
+    statistics["policy"] = m_policy == Batched ? "batched" : m_policy == Coalesced ? "coalesced" : "immediate";
+    statistics["queued_count"] = static_cast<qulonglong>(m_queued_count);
+    statistics["merged_count"] = static_cast<qulonglong>(m_merged_count);
+    statistics["dispatched_count"] = static_cast<qulonglong>(m_dispatched_count);
+    statistics["batched_count"] = static_cast<qulonglong>(m_batched_count);
+}
+
+EventCoalescer::PendingEvent *EventCoalescer::findPendingEvent(const QString &method)
+{
+    for (auto &pending_event : m_pending_events)
+    {
+        if (pending_event.method == method)
+            return &pending_event;
+    }
+    return nullptr;
+}
+
+void EventCoalescer::dispatch(const QString &method, const QVariantList &args)
+{
+    // events pending when the Python object is released are dropped.
+    if (m_py_object.isValid())
+    {
+        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+        app->dispatchPyMethod(m_py_object, method, args);
+        m_dispatched_count += 1;
+    }
+}
+
+void EventCoalescer::scheduleFlush()
+{
+    // the timer fires after the queued input events are processed, so the events arriving meanwhile are merged.
+    if (!m_flush_scheduled)
+    {
+        m_flush_scheduled = true;
+
+        DocumentWindow *document_window = m_policy == Batched ? documentWindow() : nullptr;
+
+        // a timer made stale by a flush does nothing, unless another flush was scheduled since.
+        if (document_window)
+            document_window->queueEventBatch(m_widget, this);
+        else
+            QTimer::singleShot(0, m_widget, [this]() { if (m_flush_scheduled) flush(); });
+    }
+}
+
+// return the document window containing the widget, including when the widget is in a floating dock widget.
+DocumentWindow *EventCoalescer::documentWindow() const
+{
+    for (QWidget *widget = m_widget; widget; widget = widget->parentWidget())
+    {
+        DocumentWindow *document_window = dynamic_cast<DocumentWindow *>(widget);
+        if (document_window)
+            return document_window;
+    }
+    return nullptr;
+}
+
 PyScrollArea::PyScrollArea()
+    : m_event_coalescer(this, m_py_object)
 {
     setWidgetResizable(true);  // do not set this, otherwise appearance of scroll bars reduces viewport size
 
@@ -1021,10 +1263,9 @@ void PyScrollArea::notifyViewportChanged()
     {
         float display_scaling = GetDisplayScaling();
 
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
         QPoint offset = widget()->mapFrom(viewport(), QPoint(0, 0));
         QRect viewport_rect = viewport()->rect().translated(offset.x(), offset.y());
-        app->dispatchPyMethod(m_py_object, "viewportChanged", QVariantList() << int(viewport_rect.left() / display_scaling) << int(viewport_rect.top() / display_scaling) << int(viewport_rect.width() / display_scaling) << int(viewport_rect.height() / display_scaling));
+        m_event_coalescer.queue("viewportChanged", QVariantList() << int(viewport_rect.left() / display_scaling) << int(viewport_rect.top() / display_scaling) << int(viewport_rect.width() / display_scaling) << int(viewport_rect.height() / display_scaling));
     }
 }
 
@@ -1039,11 +1280,7 @@ void PyScrollArea::focusInEvent(QFocusEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "focusIn", QVariantList());
-    }
+    m_event_coalescer.post("focusIn", QVariantList());
 
     QScrollArea::focusInEvent(event);
 }
@@ -1052,11 +1289,7 @@ void PyScrollArea::focusOutEvent(QFocusEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "focusOut", QVariantList());
-    }
+    m_event_coalescer.post("focusOut", QVariantList());
 
     QScrollArea::focusOutEvent(event);
 }
@@ -1068,8 +1301,7 @@ void PyScrollArea::resizeEvent(QResizeEvent *event)
     {
         float display_scaling = GetDisplayScaling();
 
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "sizeChanged", QVariantList() << int(event->size().width() / display_scaling) << int(event->size().height()) / display_scaling);
+        m_event_coalescer.queue("sizeChanged", QVariantList() << int(event->size().width() / display_scaling) << int(event->size().height()) / display_scaling);
         notifyViewportChanged();
     }
 }
@@ -1458,7 +1690,7 @@ void PaintCommands(QPainter &painter, const QList<CanvasDrawingCommand> &command
             QSize destination_size((destination_rect.size() * context_scaling).toSize());
 
             {
-                Python_ThreadBlock thread_block;
+                Python_ThreadBlock thread_block("paint image");
 
                 // Grab the ndarray
                 PyObjectPtr ndarray_py(QVariantToPyObject(args[2]));
@@ -1485,7 +1717,7 @@ void PaintCommands(QPainter &painter, const QList<CanvasDrawingCommand> &command
             float context_scaling = qMin(context_scaling_x, context_scaling_y);
 
             {
-                Python_ThreadBlock thread_block;
+                Python_ThreadBlock thread_block("paint data");
 
                 // Grab the ndarray
                 PyObjectPtr ndarray_py(QVariantToPyObject(args[2]));
@@ -1680,8 +1912,9 @@ inline float read_float(const quint32 *commands, unsigned int &command_index)
 
 inline double read_double(const quint32 *commands, unsigned int &command_index)
 {
-    return *(double *)(&commands[command_index]);
+    double value = *(double *)(&commands[command_index]);
     command_index += 2;
+    return value;
 }
 
 inline bool read_bool(const quint32 *commands, unsigned int &command_index)
@@ -1697,78 +1930,1652 @@ inline QString read_string(const quint32 *commands, unsigned int &command_index)
     return str;
 }
 
-struct NullDeleter {template<typename T> void operator()(T*) {} };
+/*
+ Version 2 of the binary command encoding.
+
+ A v2 stream starts with a header of 32-bit words: the magic "NC02", the flags, the string table (a count followed
+ by the strings, each encoded as in v1) and the byte length of the body. The body is a byte stream of commands, each
+ an 8-bit opcode (the index of the command in BINARY_COMMAND_SCHEMA) followed by its arguments. The body is padded
+ to a multiple of 4 bytes.
+
+ The argument types in the schema are:
+   f  coordinate; float16 if the float16 flag is set, otherwise float32.
+   a  float32.
+   i  unsigned integer; varint (LEB128) if the varint flag is set, otherwise 32 bits.
+   b  bool; 8 bits.
+   s  string; an integer index into the string table.
+   d  float64.
+   p  packed array; an integer array id and an integer word count, followed by the words if the array id is zero.
+   n  nested commands; an integer byte length followed by a body encoded with the same header.
+
+ Float16 coordinates are lossy and are only suitable for small coordinates. v2 streams are decoded to v1 before
+ painting, which costs much less than the painting itself.
+ */
+const quint32 BINARY_COMMANDS_V2_MAGIC = 0x3230434e;  // NC02
+const quint32 BINARY_COMMANDS_V2_FLOAT16 = 1;
+const quint32 BINARY_COMMANDS_V2_VARINT = 2;
 
-RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsSharedPtr &commands_v, const QMap<QString, QVariant> &imageMap, const RenderedTimeStamps &lastRenderedTimestamps, float display_scaling, int section_id, float devicePixelRatio)
+struct BinaryCommandSchema
 {
-    QSharedPointer<QPainter> painter(rawPainter, NullDeleter());
+    quint32 command;
+    const char *arguments;
+};
 
-    RenderedTimeStamps rendered_timestamps;
+// the opcode of a command is its index; new commands must only be added at the end.
+const BinaryCommandSchema BINARY_COMMAND_SCHEMA[] =
+{
+    {0x73617665, ""},  // save
+    {0x72657374, ""},  // rest, restore
+    {0x62707468, ""},  // bpth, begin path
+    {0x63707468, ""},  // cpth, close path
+    {0x636c6970, "ffff"},  // clip
+    {0x7472616e, "ff"},  // tran, translate
+    {0x7363616c, "aa"},  // scal, scale
+    {0x726f7461, "a"},  // rota, rotate
+    {0x6d6f7665, "ff"},  // move
+    {0x6c696e65, "ff"},  // line
+    {0x72656374, "ffff"},  // rect
+    {0x61726320, "fffaab"},  // arc
+    {0x61726374, "fffff"},  // arct, arc to
+    {0x63756263, "ffffff"},  // cubc, cubic to
+    {0x71756164, "ffff"},  // quad, quadratic to
+    {0x706c796c, "p"},  // plyl, polyline
+    {0x706c7967, "ip"},  // plyg, polygon
+    {0x72637473, "ipp"},  // rcts, rect batch
+    {0x6d726b73, "iaipp"},  // mrks, markers
+    {0x6466646c, "iaaaan"},  // dfdl, define display list
+    {0x7573646c, "iaaaaaai"},  // usdl, use display list
+    {0x6c797262, "iiaaaan"},  // lyrb, layer begin
+    {0x6c797265, ""},  // lyre, layer end
+    {0x73746174, "s"},  // stat, statistics
+    {0x696d6167, "iiiffff"},  // imag, image
+    {0x64617461, "iiiffffaai"},  // data, image data
+    {0x7374726b, ""},  // strk, stroke
+    {0x66696c6c, ""},  // fill
+    {0x666c7374, "s"},  // flst, fill style
+    {0x666c7367, "i"},  // flsg, fill style gradient
+    {0x74657874, "sfff"},  // text, fill text
+    {0x73747874, "sfff"},  // stxt, stroke text
+    {0x666f6e74, "s"},  // font
+    {0x616c676e, "s"},  // algn, text align
+    {0x74626173, "s"},  // tbas, text baseline
+    {0x73747374, "s"},  // stst, stroke style
+    {0x6c647368, "a"},  // ldsh, line dash
+    {0x6c696e77, "a"},  // linw, line width
+    {0x6c636170, "s"},  // lcap, line cap
+    {0x6c6e6a6e, "s"},  // lnjn, line join
+    {0x67726164, "iaaffff"},  // grad, gradient
+    {0x67726373, "ias"},  // grcs, color stop
+    {0x736c6570, "a"},  // slep, sleep
+    {0x6c61746e, "d"},  // latn, latency
+    {0x6d657367, "s"},  // mesg, message
+    {0x74696d65, "s"},  // time
+    {0x69746167, "i"},  // itag, item tag
+};
 
-    display_scaling = display_scaling ? display_scaling : GetDisplayScaling();
+const unsigned int BINARY_COMMAND_SCHEMA_COUNT = sizeof(BINARY_COMMAND_SCHEMA) / sizeof(BINARY_COMMAND_SCHEMA[0]);
 
-    QPainterPath path;
+static int BinaryCommandOpcode(quint32 command)
+{
+    static const QHash<quint32, int> opcodes = []() {
+        QHash<quint32, int> opcodes;
+        for (unsigned int i = 0; i < BINARY_COMMAND_SCHEMA_COUNT; ++i)
+            opcodes[BINARY_COMMAND_SCHEMA[i].command] = i;
+        return opcodes;
+    }();
+    return opcodes.value(command, -1);
+}
 
-    QColor fill_color(Qt::transparent);
-    int fill_gradient = -1;
+bool IsBinaryCommandsV2(const quint32 *commands, unsigned int command_count)
+{
+    return command_count > 0 && commands[0] == BINARY_COMMANDS_V2_MAGIC;
+}
 
-    QColor line_color(Qt::black);
-    float line_width = 1.0;
-    float line_dash = 0.0;
-    Qt::PenCapStyle line_cap = Qt::SquareCap;
-    Qt::PenJoinStyle line_join = Qt::BevelJoin;
+static bool DecodeBinaryCommandsV2Body(const quint8 *body, size_t body_size, quint32 flags, const std::vector<std::vector<quint32>> &strings, std::vector<quint32> &decoded_commands)
+{
+    size_t position = 0;
 
-    QFont text_font;
-    int text_baseline = 4; // alphabetic
-    int text_align = 1; // start
+    auto read_bytes = [&](void *value, size_t byte_count) {
+        if (body_size - position < byte_count)
+            return false;
+        memcpy(value, body + position, byte_count);
+        position += byte_count;
+        return true;
+    };
 
-    float context_scaling_x = 1.0;
-    float context_scaling_y = 1.0;
+    auto read_integer = [&](quint32 &value) {
+        if (!(flags & BINARY_COMMANDS_V2_VARINT))
+            return read_bytes(&value, 4);
+        value = 0;
+        for (int shift = 0; shift < 35 && position < body_size; shift += 7)
+        {
+            quint8 byte = body[position++];
+            value |= quint32(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    };
 
-    QMap<int, QGradient> gradients;
+    while (position < body_size)
+    {
+        quint8 opcode = body[position++];
 
-    painter->fillRect(painter->viewport(), QBrush(fill_color));
+        if (opcode >= BINARY_COMMAND_SCHEMA_COUNT)
+            return false;
 
-    QList<DrawingContextState> stack;
+        const BinaryCommandSchema &schema = BINARY_COMMAND_SCHEMA[opcode];
+
+        decoded_commands.push_back(qbswap(schema.command));
+
+        for (const char *argument = schema.arguments; *argument; ++argument)
+        {
+            switch (*argument)
+            {
+                case 'f':
+                {
+                    float value = 0.0;
+                    if (flags & BINARY_COMMANDS_V2_FLOAT16)
+                    {
+                        qfloat16 half_value;
+                        if (!read_bytes(&half_value, 2))
+                            return false;
+                        value = half_value;
+                    }
+                    else if (!read_bytes(&value, 4))
+                        return false;
+                    quint32 word;
+                    memcpy(&word, &value, 4);
+                    decoded_commands.push_back(word);
+                    break;
+                }
+                case 'a':
+                {
+                    quint32 word;
+                    if (!read_bytes(&word, 4))
+                        return false;
+                    decoded_commands.push_back(word);
+                    break;
+                }
+                case 'i':
+                {
+                    quint32 value;
+                    if (!read_integer(value))
+                        return false;
+                    decoded_commands.push_back(value);
+                    break;
+                }
+                case 'b':
+                {
+                    quint8 value;
+                    if (!read_bytes(&value, 1))
+                        return false;
+                    decoded_commands.push_back(value != 0);
+                    break;
+                }
+                case 's':
+                {
+                    quint32 string_index;
+                    if (!read_integer(string_index) || string_index >= strings.size())
+                        return false;
+                    decoded_commands.insert(decoded_commands.end(), strings[string_index].begin(), strings[string_index].end());
+                    break;
+                }
+                case 'd':
+                {
+                    quint32 words[2];
+                    if (!read_bytes(words, 8))
+                        return false;
+                    decoded_commands.insert(decoded_commands.end(), words, words + 2);
+                    break;
+                }
+                case 'p':
+                {
+                    quint32 array_id;
+                    quint32 word_count;
+                    if (!read_integer(array_id) || !read_integer(word_count))
+                        return false;
+                    decoded_commands.push_back(array_id);
+                    decoded_commands.push_back(word_count);
+                    if (array_id == 0)
+                    {
+                        if ((body_size - position) / 4 < word_count)
+                            return false;
+                        size_t index = decoded_commands.size();
+                        decoded_commands.resize(index + word_count);
+                        read_bytes(&decoded_commands[index], word_count * 4);
+                    }
+                    break;
+                }
+                case 'n':
+                {
+                    quint32 byte_count;
+                    if (!read_integer(byte_count) || body_size - position < byte_count)
+                        return false;
+                    std::vector<quint32> nested_commands;
+                    if (!DecodeBinaryCommandsV2Body(body + position, byte_count, flags, strings, nested_commands))
+                        return false;
+                    position += byte_count;
+                    decoded_commands.push_back(static_cast<quint32>(nested_commands.size()));
+                    decoded_commands.insert(decoded_commands.end(), nested_commands.begin(), nested_commands.end());
+                    break;
+                }
+            }
+        }
+    }
 
+    return true;
+}
+
+/*
+ Return the commands in v1 form, decoding v2 commands. Returns null if the v2 commands are malformed.
+
+ Commands are decoded once when they are submitted so that painting does not copy them each frame.
+ */
+CommandsSharedPtr DecodeBinaryCommands(const CommandsSharedPtr &commands)
+{
+    if (!commands || !IsBinaryCommandsV2(commands->data(), static_cast<unsigned int>(commands->size())))
+        return commands;
+
+    CommandsSharedPtr decoded_commands(new std::vector<quint32>());
+    if (!DecodeBinaryCommandsV2(commands->data(), static_cast<unsigned int>(commands->size()), *decoded_commands))
+        return CommandsSharedPtr();
+
+    return decoded_commands;
+}
+
+/*
+ Decode a v2 command stream into the equivalent v1 command stream. Returns false if the stream is malformed.
+ */
+bool DecodeBinaryCommandsV2(const quint32 *commands, unsigned int command_count, std::vector<quint32> &decoded_commands)
+{
     unsigned int command_index = 0;
 
-    const quint32 *commands = commands_v->data();
+    if (command_count < 4 || read_uint32(commands, command_index) != BINARY_COMMANDS_V2_MAGIC)
+        return false;
 
-    extern QElapsedTimer timer;
-    extern qint64 timer_offset_ns;
+    quint32 flags = read_uint32(commands, command_index);
+    quint32 string_count = read_uint32(commands, command_index);
+
+    std::vector<std::vector<quint32>> strings;
+    strings.reserve(qMin(string_count, command_count));
 
-    while (command_index < commands_v->size())
+    for (quint32 i = 0; i < string_count; ++i)
     {
-        quint32 cmd_hex = read_uint32(commands, command_index);
-        quint32 cmd = (cmd_hex & 0x000000FF) << 24 |
-                      (cmd_hex & 0x0000FF00) << 8 |
-                      (cmd_hex & 0x00FF0000) >> 8 |
-                      (cmd_hex & 0xFF000000) >> 24;
+        if (command_index >= command_count)
+            return false;
+        quint32 word_count = 1 + (commands[command_index] / 4) + (commands[command_index] % 4 != 0);
+        if (word_count > command_count - command_index)
+            return false;
+        strings.emplace_back(&commands[command_index], &commands[command_index] + word_count);
+        command_index += word_count;
+    }
 
-        // qint64 start = qint64(timer.nsecsElapsed() / 1.0E3);
+    if (command_index >= command_count)
+        return false;
 
-        switch (cmd)
+    quint32 body_size = read_uint32(commands, command_index);
+
+    if ((command_count - command_index) < body_size / 4 + (body_size % 4 != 0))
+        return false;
+
+    decoded_commands.clear();
+    decoded_commands.reserve(command_count * 2);
+
+    return DecodeBinaryCommandsV2Body(reinterpret_cast<const quint8 *>(&commands[command_index]), body_size, flags, strings, decoded_commands);
+}
+
+static bool EncodeBinaryCommandsV2Body(const quint32 *commands, unsigned int command_count, quint32 flags, QHash<QByteArray, quint32> &string_indexes, std::vector<QByteArray> &strings, std::vector<quint8> &body)
+{
+    auto write_bytes = [&](const void *value, size_t byte_count) {
+        body.insert(body.end(), static_cast<const quint8 *>(value), static_cast<const quint8 *>(value) + byte_count);
+    };
+
+    auto write_integer = [&](quint32 value) {
+        if (!(flags & BINARY_COMMANDS_V2_VARINT))
         {
-            case 0x73617665:  // save
+            write_bytes(&value, 4);
+            return;
+        }
+        while (value >= 0x80)
+        {
+            body.push_back(quint8(value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        body.push_back(quint8(value));
+    };
+
+    unsigned int command_index = 0;
+
+    while (command_index < command_count)
+    {
+        int opcode = BinaryCommandOpcode(qbswap(read_uint32(commands, command_index)));
+
+        if (opcode < 0)
+            return false;
+
+        body.push_back(quint8(opcode));
+
+        for (const char *argument = BINARY_COMMAND_SCHEMA[opcode].arguments; *argument; ++argument)
+        {
+            // every argument takes at least one word in v1.
+            if (command_index >= command_count)
+                return false;
+
+            switch (*argument)
             {
-                DrawingContextState values;
-                values.fill_color = fill_color;
-                values.fill_gradient = fill_gradient;
-                values.line_color = line_color;
-                values.line_width = line_width;
-                values.line_dash = line_dash;
-                values.line_cap = line_cap;
-                values.line_join = line_join;
-                values.text_font = text_font;
-                values.text_baseline = text_baseline;
-                values.text_align = text_align;
-                values.gradients = gradients;
-                values.path = path;
-                values.context_scaling_x = context_scaling_x;
-                values.context_scaling_y = context_scaling_y;
-                stack.push_back(values);
+                case 'f':
+                {
+                    if (flags & BINARY_COMMANDS_V2_FLOAT16)
+                    {
+                        qfloat16 half_value(read_float(commands, command_index));
+                        write_bytes(&half_value, 2);
+                    }
+                    else
+                        write_bytes(&commands[command_index++], 4);
+                    break;
+                }
+                case 'a':
+                    write_bytes(&commands[command_index++], 4);
+                    break;
+                case 'i':
+                    write_integer(read_uint32(commands, command_index));
+                    break;
+                case 'b':
+                    body.push_back(read_bool(commands, command_index) ? 1 : 0);
+                    break;
+                case 's':
+                {
+                    quint32 length = read_uint32(commands, command_index);
+                    quint32 word_count = (length / 4) + (length % 4 != 0);
+                    if (word_count > command_count - command_index)
+                        return false;
+                    QByteArray string(reinterpret_cast<const char *>(&commands[command_index]), length);
+                    command_index += word_count;
+                    auto iter = string_indexes.find(string);
+                    if (iter == string_indexes.end())
+                    {
+                        iter = string_indexes.insert(string, static_cast<quint32>(strings.size()));
+                        strings.push_back(string);
+                    }
+                    write_integer(iter.value());
+                    break;
+                }
+                case 'd':
+                {
+                    if (command_count - command_index < 2)
+                        return false;
+                    write_bytes(&commands[command_index], 8);
+                    command_index += 2;
+                    break;
+                }
+                case 'p':
+                {
+                    if (command_count - command_index < 2)
+                        return false;
+                    quint32 array_id = read_uint32(commands, command_index);
+                    quint32 word_count = read_uint32(commands, command_index);
+                    write_integer(array_id);
+                    write_integer(word_count);
+                    if (array_id == 0)
+                    {
+                        if (word_count > command_count - command_index)
+                            return false;
+                        write_bytes(&commands[command_index], word_count * 4);
+                        command_index += word_count;
+                    }
+                    break;
+                }
+                case 'n':
+                {
+                    quint32 word_count = read_uint32(commands, command_index);
+                    if (word_count > command_count - command_index)
+                        return false;
+                    std::vector<quint8> nested_body;
+                    if (!EncodeBinaryCommandsV2Body(&commands[command_index], word_count, flags, string_indexes, strings, nested_body))
+                        return false;
+                    command_index += word_count;
+                    write_integer(static_cast<quint32>(nested_body.size()));
+                    body.insert(body.end(), nested_body.begin(), nested_body.end());
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ Encode a v1 command stream as a v2 command stream. Returns false if the stream is malformed or contains a command
+ missing from the schema.
+ */
+bool EncodeBinaryCommandsV2(const quint32 *commands, unsigned int command_count, quint32 flags, std::vector<quint32> &encoded_commands)
+{
+    QHash<QByteArray, quint32> string_indexes;
+    std::vector<QByteArray> strings;
+    std::vector<quint8> body;
+
+    body.reserve(command_count * 4);
+
+    if (!EncodeBinaryCommandsV2Body(commands, command_count, flags, string_indexes, strings, body))
+        return false;
+
+    encoded_commands.clear();
+    encoded_commands.push_back(BINARY_COMMANDS_V2_MAGIC);
+    encoded_commands.push_back(flags);
+    encoded_commands.push_back(static_cast<quint32>(strings.size()));
+
+    for (const auto &string : strings)
+    {
+        encoded_commands.push_back(static_cast<quint32>(string.size()));
+        size_t index = encoded_commands.size();
+        encoded_commands.resize(index + (string.size() + 3) / 4, 0);
+        memcpy(&encoded_commands[index], string.constData(), string.size());
+    }
+
+    encoded_commands.push_back(static_cast<quint32>(body.size()));
+    size_t index = encoded_commands.size();
+    encoded_commands.resize(index + (body.size() + 3) / 4, 0);
+    if (!body.empty())
+        memcpy(&encoded_commands[index], body.data(), body.size());
+
+    return true;
+}
+
+/*
+ Return whether drawing the v1 commands may block the drawing thread: image and data commands and packed arrays
+ stored in the image map, which require Python, and sleep commands. Malformed commands are reported as blocking.
+ */
+bool BinaryCommandsMayBlock(const quint32 *commands, unsigned int command_count)
+{
+    unsigned int command_index = 0;
+
+    while (command_index < command_count)
+    {
+        quint32 command = qbswap(read_uint32(commands, command_index));
+        int opcode = BinaryCommandOpcode(command);
+
+        if (opcode < 0 || command == 0x696d6167 || command == 0x64617461 || command == 0x736c6570)  // imag, data, slep
+            return true;
+
+        for (const char *argument = BINARY_COMMAND_SCHEMA[opcode].arguments; *argument; ++argument)
+        {
+            if (command_index >= command_count)
+                return true;
+
+            switch (*argument)
+            {
+                case 's':
+                {
+                    quint32 length = read_uint32(commands, command_index);
+                    quint32 word_count = (length / 4) + (length % 4 != 0);
+                    if (word_count > command_count - command_index)
+                        return true;
+                    command_index += word_count;
+                    break;
+                }
+                case 'd':
+                    if (command_count - command_index < 2)
+                        return true;
+                    command_index += 2;
+                    break;
+                case 'p':
+                {
+                    if (command_count - command_index < 2)
+                        return true;
+                    quint32 array_id = read_uint32(commands, command_index);
+                    quint32 word_count = read_uint32(commands, command_index);
+                    if (array_id != 0 || word_count > command_count - command_index)
+                        return true;
+                    command_index += word_count;
+                    break;
+                }
+                case 'n':
+                {
+                    quint32 word_count = read_uint32(commands, command_index);
+                    if (word_count > command_count - command_index || BinaryCommandsMayBlock(&commands[command_index], word_count))
+                        return true;
+                    command_index += word_count;
+                    break;
+                }
+                default:
+                    command_index += 1;
+                    break;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*
+ A packed array argument is either stored inline in the command stream or references an ndarray in the image map.
+
+ The argument is encoded as an array id followed by a count of 32-bit words. If the array id is zero, the words
+ follow inline in the command stream. Otherwise the words are copied from the contiguous ndarray stored under the
+ array id in the image map (all of them if the count is zero) and nothing more is read from the command stream.
+ */
+struct PackedArray
+{
+    const quint32 *data;
+    unsigned int size;
+    std::vector<quint32> storage;
+
+    PackedArray() : data(nullptr), size(0) { }
+
+    float floatAt(unsigned int index) const { return *(const float *)(&data[index]); }
+};
+
+inline void read_packed_array(const quint32 *commands, unsigned int &command_index, unsigned int command_count, const QMap<QString, QVariant> &imageMap, PackedArray &packed_array)
+{
+    quint32 array_id = read_uint32(commands, command_index);
+    quint32 word_count = read_uint32(commands, command_index);
+
+    if (array_id == 0)
+    {
+        word_count = command_index < command_count ? qMin(word_count, command_count - command_index) : 0;
+        packed_array.data = &commands[command_index];
+        packed_array.size = word_count;
+        command_index += word_count;
+    }
+    else
+    {
+        QString array_key = QString::number(array_id);
+
+        if (imageMap.contains(array_key))
+        {
+            Python_ThreadBlock thread_block("read packed array");
+
+            PyObjectPtr ndarray_py(QVariantToPyObject(imageMap[array_key]));
+            if (ndarray_py)
+                PythonSupport::instance()->wordsFromArray(ndarray_py, word_count, packed_array.storage);
+        }
+        else
+            qDebug() << "missing " << array_key;
+
+        packed_array.data = packed_array.storage.data();
+        packed_array.size = static_cast<unsigned int>(packed_array.storage.size());
+    }
+}
+
+static QPen MakeStrokePen(const QColor &line_color, float line_width, float line_dash, Qt::PenCapStyle line_cap, Qt::PenJoinStyle line_join, float display_scaling)
+{
+    QPen pen(line_color);
+    pen.setWidthF(line_width * display_scaling);
+    pen.setJoinStyle(line_join);
+    pen.setCapStyle(line_cap);
+    if (line_dash > 0.0)
+    {
+        QVector<qreal> dashes;
+        dashes << line_dash * display_scaling << line_dash * display_scaling;
+        pen.setDashPattern(dashes);
+    }
+    return pen;
+}
+
+static QPolygonF PolygonFromPackedArray(const PackedArray &points, float display_scaling)
+{
+    unsigned int point_count = points.size / 2;
+    QPolygonF polygon(point_count);
+    for (unsigned int i = 0; i < point_count; ++i)
+        polygon[i] = QPointF(points.floatAt(i * 2) * display_scaling, points.floatAt(i * 2 + 1) * display_scaling);
+    return polygon;
+}
+
+enum MarkerShape
+{
+    MarkerShape_Circle = 0,
+    MarkerShape_Cross = 1,
+    MarkerShape_Square = 2,
+};
+
+static inline float MarkerMargin(const QPen &pen)
+{
+    return std::ceil(pen.widthF() + 1.0);
+}
+
+/*
+ Render a single marker into an image at the device scale so that it can be blitted once per point.
+
+ The image has its device pixel ratio set so that drawing it at a logical position covers the marker plus
+ a margin (see MarkerMargin) in logical coordinates.
+ */
+static QImage MakeMarkerImage(int shape, float marker_size, bool fill, bool stroke, const QBrush &brush, const QPen &pen, float device_scale)
+{
+    float margin = MarkerMargin(pen);
+    float logical_size = marker_size + 2 * margin;
+    int image_size = qMax(1, static_cast<int>(std::ceil(logical_size * device_scale)));
+    QImage image(image_size, image_size, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(device_scale);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHints(DEFAULT_RENDER_HINTS);
+    QRectF marker_rect(margin, margin, marker_size, marker_size);
+    painter.setPen(stroke || shape == MarkerShape_Cross ? pen : QPen(Qt::NoPen));
+    painter.setBrush(fill && shape != MarkerShape_Cross ? brush : QBrush(Qt::NoBrush));
+    switch (shape)
+    {
+        case MarkerShape_Cross:
+            painter.drawLine(marker_rect.topLeft(), marker_rect.bottomRight());
+            painter.drawLine(marker_rect.bottomLeft(), marker_rect.topRight());
+            break;
+        case MarkerShape_Square:
+            painter.drawRect(marker_rect);
+            break;
+        default:
+            painter.drawEllipse(marker_rect);
+            break;
+    }
+    return image;
+}
+
+// return the Python object held in an image map entry without acquiring the GIL or changing its reference count.
+static PyObject *ImageMapObject(const QVariant &value)
+{
+    if (value.userType() == PyObjectPtr_metaId())
+        return static_cast<const PyObjectPtr *>(value.constData())->get();
+    return nullptr;
+}
+
+static bool ImageMapsIdentical(const QMap<QString, QVariant> &image_map1, const QMap<QString, QVariant> &image_map2)
+{
+    if (image_map1.size() != image_map2.size())
+        return false;
+    for (auto iter1 = image_map1.constBegin(), iter2 = image_map2.constBegin(); iter1 != image_map1.constEnd(); ++iter1, ++iter2)
+    {
+        if (iter1.key() != iter2.key())
+            return false;
+        // arrays are compared by identity; other values, which are not Python objects, by value.
+        PyObject *py_object1 = ImageMapObject(iter1.value());
+        PyObject *py_object2 = ImageMapObject(iter2.value());
+        if ((py_object1 || py_object2) ? py_object1 != py_object2 : iter1.value() != iter2.value())
+            return false;
+    }
+    return true;
+}
+
+DrawingCommands::DrawingCommands(const CommandsSharedPtr &commands, const QRect &rect, const QMap<QString, QVariant> &image_map, const QRect &dirty_rect)
+    : m_commands(commands)
+    , m_paint_commands(DecodeBinaryCommands(commands))
+    , m_image_map(image_map)
+    , m_rect(rect)
+    , m_dirty_rect(dirty_rect)
+{
+}
+
+// copy the drawing commands with another dirty rect, without decoding them again.
+DrawingCommands::DrawingCommands(const DrawingCommands &drawing_commands, const QRect &dirty_rect)
+    : m_commands(drawing_commands.m_commands)
+    , m_paint_commands(drawing_commands.m_paint_commands)
+    , m_image_map(drawing_commands.m_image_map)
+    , m_rect(drawing_commands.m_rect)
+    , m_dirty_rect(dirty_rect)
+{
+}
+
+/*
+ Return whether the drawing commands would render identically.
+
+ Arrays in the image map are compared by identity, so arrays modified in place are not detected. Since the previous
+ drawing commands hold references to their arrays, a new array cannot have the same identity as an old one.
+ */
+bool DrawingCommands::isIdentical(const DrawingCommands &drawing_commands) const
+{
+    if (m_rect != drawing_commands.m_rect || !ImageMapsIdentical(m_image_map, drawing_commands.m_image_map))
+        return false;
+    if (!m_commands || !drawing_commands.m_commands)
+        return m_commands == drawing_commands.m_commands;
+    if (m_commands->size() != drawing_commands.m_commands->size())
+        return false;
+    return m_commands->empty() || memcmp(m_commands->data(), drawing_commands.m_commands->data(), m_commands->size() * sizeof(quint32)) == 0;
+}
+
+DisplayList::DisplayList(const CommandsSharedPtr &commands, const QMap<QString, QVariant> &image_map, const QRectF &bounds)
+    : raster_use_count(0)
+    , m_commands(DecodeBinaryCommands(commands))
+    , m_image_map(image_map)
+    , m_bounds(bounds)
+    , m_may_block(m_commands && BinaryCommandsMayBlock(m_commands->data(), static_cast<unsigned int>(m_commands->size())))
+{
+}
+
+bool DisplayList::isIdentical(const DisplayList &display_list) const
+{
+    if (m_bounds != display_list.m_bounds || !ImageMapsIdentical(m_image_map, display_list.m_image_map))
+        return false;
+    if (!m_commands || !display_list.m_commands)
+        return m_commands == display_list.m_commands;
+    return *m_commands == *display_list.m_commands;
+}
+
+/*
+ Define the display list with the given id.
+
+ A display list identical to the existing definition is ignored so that the existing raster cache stays valid
+ when a client redefines a display list with the same content each frame.
+ */
+void DisplayListRegistry::define(int display_list_id, const DisplayListSharedPtr &display_list)
+{
+    // ensure the original gets released outside of the lock by assigning it to this variable.
+    DisplayListSharedPtr old_display_list;
+
+    QMutexLocker locker(&m_mutex);
+
+    old_display_list = m_display_lists.value(display_list_id);
+
+    if (!old_display_list || !old_display_list->isIdentical(*display_list))
+    {
+        m_display_lists[display_list_id] = display_list;
+        m_generation.fetchAndAddOrdered(1);
+    }
+}
+
+void DisplayListRegistry::remove(int display_list_id)
+{
+    // ensure the original gets released outside of the lock by assigning it to this variable.
+    DisplayListSharedPtr old_display_list;
+
+    QMutexLocker locker(&m_mutex);
+
+    old_display_list = m_display_lists.take(display_list_id);
+
+    if (old_display_list)
+        m_generation.fetchAndAddOrdered(1);
+}
+
+DisplayListSharedPtr DisplayListRegistry::get(int display_list_id)
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_display_lists.value(display_list_id);
+}
+
+/*
+ The source array of a data command, used to read the raw value under a point without calling into Python.
+
+ The probe holds a buffer on the array, which keeps its memory valid, so values can be read without the GIL. The
+ transform maps the world coordinates of the data command to canvas coordinates once the section is rendered.
+ */
+class DataProbe
+{
+public:
+    DataProbe(int image_id, const QRectF &destination_rect, const QTransform &transform)
+    : m_image_id(image_id), m_destination_rect(destination_rect), m_transform(transform), m_valid(false) { }
+
+    // a probe on the buffer of another probe with another transform; used to draw a cached raster again.
+    DataProbe(const DataProbeSharedPtr &source, const QTransform &transform)
+    : m_image_id(source->m_image_id), m_destination_rect(source->m_destination_rect), m_transform(transform)
+    , m_buffer(source->m_buffer), m_valid(source->m_valid), m_source(source) { }
+
+    ~DataProbe()
+    {
+        // probes are destroyed on render threads; do not block them on the GIL.
+        if (m_valid && !m_source)
+            ReleasePyBuffer(m_buffer);
+    }
+
+    // acquire the buffer of the array. must be called with the GIL held.
+    bool acquire(PyObject *ndarray_py)
+    {
+        m_valid = PythonSupport::instance()->bufferGet(ndarray_py, &m_buffer);
+        if (m_valid && (m_buffer.ndim != 2 || !m_buffer.shape || !m_buffer.strides || m_buffer.shape[0] <= 0 || m_buffer.shape[1] <= 0))
+        {
+            PythonSupport::instance()->bufferRelease(&m_buffer);
+            m_valid = false;
+        }
+        return m_valid;
+    }
+
+    void setTransform(const QTransform &transform) { m_transform = transform; }
+    const QTransform &transform() const { return m_transform; }
+
+    QRectF bounds() const { return m_transform.mapRect(m_destination_rect); }
+
+    bool probe(const QPointF &point, QVariantMap &result) const
+    {
+        bool invertible = false;
+        QPointF world_point = m_transform.inverted(&invertible).map(point);
+        if (!m_valid || !invertible || !m_destination_rect.contains(world_point))
+            return false;
+        const Py_ssize_t height = m_buffer.shape[0];
+        const Py_ssize_t width = m_buffer.shape[1];
+        Py_ssize_t x = qBound(Py_ssize_t(0), Py_ssize_t((world_point.x() - m_destination_rect.left()) / m_destination_rect.width() * width), width - 1);
+        Py_ssize_t y = qBound(Py_ssize_t(0), Py_ssize_t((world_point.y() - m_destination_rect.top()) / m_destination_rect.height() * height), height - 1);
+        const char *p = static_cast<const char *>(m_buffer.buf) + y * m_buffer.strides[0] + x * m_buffer.strides[1];
+        QVariant value;
+        // only native byte order formats are supported.
+        const char *format = m_buffer.format ? m_buffer.format : "B";
+        if (*format == '@' || *format == '=' || (*format == '<' && Q_BYTE_ORDER == Q_LITTLE_ENDIAN))
+            format += 1;
+        if (strlen(format) != 1)
+            return false;
+        switch (*format)
+        {
+            case 'b': value = int(*reinterpret_cast<const qint8 *>(p)); break;
+            case 'B': value = uint(*reinterpret_cast<const quint8 *>(p)); break;
+            case 'h': value = int(*reinterpret_cast<const qint16 *>(p)); break;
+            case 'H': value = uint(*reinterpret_cast<const quint16 *>(p)); break;
+            case 'i': value = *reinterpret_cast<const qint32 *>(p); break;
+            case 'I': value = *reinterpret_cast<const quint32 *>(p); break;
+            case 'l':
+            case 'q': value = m_buffer.itemsize == 8 ? qlonglong(*reinterpret_cast<const qint64 *>(p)) : qlonglong(*reinterpret_cast<const qint32 *>(p)); break;
+            case 'L':
+            case 'Q': value = m_buffer.itemsize == 8 ? qulonglong(*reinterpret_cast<const quint64 *>(p)) : qulonglong(*reinterpret_cast<const quint32 *>(p)); break;
+            case 'e': value = double(*reinterpret_cast<const qfloat16 *>(p)); break;
+            case 'f': value = double(*reinterpret_cast<const float *>(p)); break;
+            case 'd': value = *reinterpret_cast<const double *>(p); break;
+            default: return false;
+        }
+        result["image_id"] = m_image_id;
+        result["x"] = qlonglong(x);
+        result["y"] = qlonglong(y);
+        result["value"] = value;
+        return true;
+    }
+
+private:
+    int m_image_id;
+    QRectF m_destination_rect;
+    QTransform m_transform;
+    Py_buffer m_buffer;
+    bool m_valid;
+    DataProbeSharedPtr m_source;  // holds the buffer when it is shared
+};
+
+// the maximum nesting of display lists; guards against display lists that use themselves.
+const int MAX_DISPLAY_LIST_DEPTH = 8;
+
+// the largest raster (in device pixels) cached for a display list or layer; larger ones are drawn directly.
+const int MAX_RASTER_SIZE = 4096;
+
+// the maximum number of rasters cached for a display list, each for another transform or raster mode.
+const int MAX_DISPLAY_LIST_RASTERS = 4;
+
+// the maximum total size (in bytes) of the layer rasters cached for a canvas.
+const qint64 MAX_LAYER_CACHE_BYTES = 64 * 1024 * 1024;
+
+/*
+ Render commands into a raster using the linear part of the painter transform.
+
+ The bounds are in scaled (not device) coordinates. Returns a null image if the raster would be empty or larger
+ than MAX_RASTER_SIZE. The raster rect is the device rect of the raster relative to the translation of the
+ device transform. The tagged bounds are always recorded, in raster pixels, since the raster may be drawn later with
+ a context that records them. Likewise for the data probes, whose transforms map to raster pixels.
+ */
+static QImage RasterizeBinaryCommands(QPainter *painter, const CommandsSharedPtr &commands, const QMap<QString, QVariant> &imageMap, const QRectF &bounds, const QTransform &linear_transform, float display_scaling, float devicePixelRatio, PaintBinaryContext *context, QRect &raster_rect, QVector<TaggedBounds> &raster_tagged_bounds, DataProbes &raster_data_probes)
+{
+    raster_rect = linear_transform.mapRect(bounds).toAlignedRect();
+    raster_tagged_bounds.clear();
+    raster_data_probes.clear();
+
+    if (raster_rect.isEmpty() || raster_rect.width() > MAX_RASTER_SIZE || raster_rect.height() > MAX_RASTER_SIZE)
+        return QImage();
+
+    PaintBinaryContext raster_context = context ? *context : PaintBinaryContext();
+    raster_context.tagged_bounds = &raster_tagged_bounds;
+    raster_context.data_probes = &raster_data_probes;
+
+    QImage raster_image(raster_rect.size(), QImage::Format_ARGB32_Premultiplied);
+    raster_image.fill(Qt::transparent);
+    QPainter raster_painter(&raster_image);
+    raster_painter.setRenderHints(painter->renderHints());
+    raster_painter.translate(-raster_rect.topLeft());
+    raster_painter.setTransform(linear_transform, true);
+    PaintBinaryCommands(&raster_painter, commands, imageMap, RenderedTimeStamps(), display_scaling, 0, devicePixelRatio, &raster_context);
+    raster_painter.end();
+
+    return raster_image;
+}
+
+// the translation of the painter transform in the device pixels of the paint device, snapped to whole pixels.
+static QPoint RasterOrigin(QPainter *painter)
+{
+    qreal device_scale = painter->device()->devicePixelRatioF();
+    QTransform device_transform = painter->transform();
+    return QPoint(qRound(device_transform.dx() * device_scale), qRound(device_transform.dy() * device_scale));
+}
+
+/*
+ Draw a raster produced by RasterizeBinaryCommands, snapping the translation to device pixels.
+
+ The tagged bounds and data probes of the raster are mapped to the coordinates of the combined transform of the
+ painter, where those of primitives drawn directly are recorded. Like the culling pass, only visible ones are
+ recorded. The cached data probes are shared between threads, so new probes on their buffers are recorded.
+ */
+static void PaintRaster(QPainter *painter, const QRect &raster_rect, const QImage &raster_image, const QVector<TaggedBounds> &raster_tagged_bounds, const DataProbes &raster_data_probes, PaintBinaryContext *context)
+{
+    qreal device_scale = painter->device()->devicePixelRatioF();
+    QPoint raster_origin = RasterOrigin(painter);
+    bool record_tagged_bounds = context && context->tagged_bounds && !raster_tagged_bounds.isEmpty();
+    bool record_data_probes = context && context->data_probes && !raster_data_probes.isEmpty();
+    if (record_tagged_bounds || record_data_probes)
+    {
+        QTransform raster_transform = QTransform::fromTranslate(raster_origin.x() + raster_rect.left(), raster_origin.y() + raster_rect.top()) * QTransform::fromScale(1.0 / device_scale, 1.0 / device_scale);
+        QRectF visible_rect(painter->viewport());
+        if (painter->hasClipping())
+            visible_rect &= painter->combinedTransform().mapRect(painter->clipBoundingRect());
+        if (record_tagged_bounds)
+        {
+            for (auto const &entry : raster_tagged_bounds)
+            {
+                QRectF bounds = raster_transform.mapRect(entry.bounds);
+                if (bounds.intersects(visible_rect))
+                    context->tagged_bounds->append(TaggedBounds(bounds, entry.tag));
+            }
+        }
+        if (record_data_probes)
+        {
+            for (auto const &raster_data_probe : raster_data_probes)
+            {
+                DataProbeSharedPtr data_probe(new DataProbe(raster_data_probe, raster_data_probe->transform() * raster_transform));
+                if (data_probe->bounds().intersects(visible_rect))
+                    context->data_probes->append(data_probe);
+            }
+        }
+    }
+    painter->save();
+    painter->resetTransform();
+    // the raster is in device pixels, which differ from the painter coordinates on high dpi widgets.
+    painter->scale(1.0 / device_scale, 1.0 / device_scale);
+    painter->drawImage(raster_origin + raster_rect.topLeft(), raster_image);
+    painter->restore();
+}
+
+static QTransform LinearTransform(const QTransform &transform)
+{
+    return QTransform(transform.m11(), transform.m12(), transform.m21(), transform.m22(), 0.0, 0.0);
+}
+
+// the linear part of the painter transform in the device pixels of the paint device; rasters are made with it.
+static QTransform RasterTransform(QPainter *painter)
+{
+    qreal device_scale = painter->device()->devicePixelRatioF();
+    return LinearTransform(painter->transform()) * QTransform::fromScale(device_scale, device_scale);
+}
+
+/*
+ Return the painting state, other than the transform, that a raster depends on.
+
+ Rasters rendered in another mode (for instance the interactive mode without antialiasing) must not be reused.
+ */
+static quint64 RasterMode(QPainter *painter, const PaintBinaryContext *context)
+{
+    quint64 raster_mode = static_cast<quint32>(painter->renderHints()) & 0xFFFF;
+    if (context)
+    {
+        quint32 stroke_tolerance_bits = 0;
+        memcpy(&stroke_tolerance_bits, &context->stroke_tolerance, sizeof(stroke_tolerance_bits));
+        raster_mode |= static_cast<quint64>(context->downscale_mode) << 16;
+        raster_mode |= static_cast<quint64>(context->font_hinting) << 20;
+        raster_mode |= static_cast<quint64>(stroke_tolerance_bits) << 32;
+    }
+    return raster_mode;
+}
+
+/*
+ Draw the display list from its raster cache, rendering the raster first if required.
+
+ The raster is rendered with the linear part of the current device transform and is reused when drawn again with
+ the same linear part and raster mode. Up to MAX_DISPLAY_LIST_RASTERS rasters are kept, evicting the least recently
+ used one. Returns false if the display list cannot be rasterized, in which case the caller
+ should draw it directly. A display list that is already being rasterized by this thread, because it uses itself,
+ is not rasterized again; drawing it directly is then limited by MAX_DISPLAY_LIST_DEPTH.
+
+ The raster mutex is not held while rendering, so two threads may render the same raster; the last one is kept.
+ */
+static bool PaintDisplayListRaster(QPainter *painter, DisplayList &display_list, float display_scaling, float devicePixelRatio, PaintBinaryContext *context)
+{
+    for (const DisplayListRasterStack *raster_stack = context->raster_stack; raster_stack; raster_stack = raster_stack->next)
+    {
+        if (raster_stack->display_list == &display_list)
+            return false;
+    }
+
+    const QRectF &logical_bounds = display_list.bounds();
+    QRectF bounds(logical_bounds.x() * display_scaling, logical_bounds.y() * display_scaling, logical_bounds.width() * display_scaling, logical_bounds.height() * display_scaling);
+    QTransform linear_transform = RasterTransform(painter);
+    quint64 raster_mode = RasterMode(painter, context);
+
+    QImage raster_image;
+    QRect raster_rect;
+    QVector<TaggedBounds> raster_tagged_bounds;
+    DataProbes raster_data_probes;
+
+    // ensure the replaced raster gets released outside of the lock by assigning it to this variable.
+    CachedRaster old_raster;
+
+    bool is_cached = false;
+
+    {
+        QMutexLocker locker(&display_list.raster_mutex);
+
+        for (CachedRaster &raster : display_list.rasters)
+        {
+            if (raster.raster_transform == linear_transform && raster.raster_mode == raster_mode)
+            {
+                raster.last_used = ++display_list.raster_use_count;
+                raster_image = raster.raster_image;
+                raster_rect = raster.raster_rect;
+                raster_tagged_bounds = raster.raster_tagged_bounds;
+                raster_data_probes = raster.raster_data_probes;
+                is_cached = true;
+                break;
+            }
+        }
+    }
+
+    if (!is_cached)
+    {
+        DisplayListRasterStack raster_stack = { &display_list, context->raster_stack };
+        PaintBinaryContext raster_context(*context);
+        raster_context.raster_stack = &raster_stack;
+
+        raster_image = RasterizeBinaryCommands(painter, display_list.commands(), display_list.imageMap(), bounds, linear_transform, display_scaling, devicePixelRatio, &raster_context, raster_rect, raster_tagged_bounds, raster_data_probes);
+
+        if (raster_image.isNull())
+            return false;
+
+        QMutexLocker locker(&display_list.raster_mutex);
+
+        // replace the raster rendered by another thread meanwhile, or else the least recently used one if full.
+        QVector<CachedRaster> &rasters = display_list.rasters;
+        int raster_index = -1;
+        for (int i = 0; i < rasters.size(); ++i)
+        {
+            if (rasters[i].raster_transform == linear_transform && rasters[i].raster_mode == raster_mode)
+            {
+                raster_index = i;
+                break;
+            }
+            if (rasters.size() >= MAX_DISPLAY_LIST_RASTERS && (raster_index < 0 || rasters[i].last_used < rasters[raster_index].last_used))
+                raster_index = i;
+        }
+        if (raster_index < 0)
+        {
+            raster_index = rasters.size();
+            rasters.append(CachedRaster());
+        }
+
+        CachedRaster &raster = rasters[raster_index];
+        std::swap(old_raster, raster);
+        raster.raster_transform = linear_transform;
+        raster.raster_mode = raster_mode;
+        raster.raster_rect = raster_rect;
+        raster.raster_image = raster_image;
+        raster.raster_tagged_bounds = raster_tagged_bounds;
+        raster.raster_data_probes = raster_data_probes;
+        raster.last_used = ++display_list.raster_use_count;
+    }
+
+    PaintRaster(painter, raster_rect, raster_image, raster_tagged_bounds, raster_data_probes, context);
+
+    return true;
+}
+
+bool LayerCache::find(quint32 key, quint32 version, const QTransform &raster_transform, quint64 raster_mode, QRect &raster_rect, QImage &raster_image, QVector<TaggedBounds> &raster_tagged_bounds, DataProbes &raster_data_probes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto iter = m_entries.find(key);
+
+    if (iter != m_entries.end())
+    {
+        for (LayerCacheEntry &entry : *iter)
+        {
+            if (entry.version == version && entry.raster_transform == raster_transform && entry.raster_mode == raster_mode)
+            {
+                entry.last_used = ++m_use_count;
+                raster_rect = entry.raster_rect;
+                raster_image = entry.raster_image;
+                raster_tagged_bounds = entry.raster_tagged_bounds;
+                raster_data_probes = entry.raster_data_probes;
+                m_hit_count += 1;
+                return true;
+            }
+        }
+    }
+
+    m_miss_count += 1;
+    return false;
+}
+
+void LayerCache::insert(quint32 key, quint32 version, const QTransform &raster_transform, quint64 raster_mode, const QRect &raster_rect, const QImage &raster_image, const QVector<TaggedBounds> &raster_tagged_bounds, const DataProbes &raster_data_probes)
+{
+    // ensure the evicted rasters and data probes get released outside of the lock by collecting them in this list.
+    QList<LayerCacheEntry> old_entries;
+
+    QMutexLocker locker(&m_mutex);
+
+    // drop the rasters of other versions and the raster being replaced.
+    QVector<LayerCacheEntry> &entries = m_entries[key];
+    for (int i = entries.size() - 1; i >= 0; --i)
+    {
+        const LayerCacheEntry &entry = entries[i];
+        if (entry.version != version || (entry.raster_transform == raster_transform && entry.raster_mode == raster_mode))
+        {
+            m_byte_count -= entry.raster_image.sizeInBytes();
+            old_entries.append(entry);
+            entries.remove(i);
+        }
+    }
+
+    LayerCacheEntry entry;
+    entry.version = version;
+    entry.raster_transform = raster_transform;
+    entry.raster_mode = raster_mode;
+    entry.raster_rect = raster_rect;
+    entry.raster_image = raster_image;
+    entry.raster_tagged_bounds = raster_tagged_bounds;
+    entry.raster_data_probes = raster_data_probes;
+    entry.last_used = ++m_use_count;
+    entries.append(entry);
+    m_byte_count += raster_image.sizeInBytes();
+
+    // evict the least recently used rasters, other than the one just inserted, which is the most recently used.
+    while (m_byte_count > MAX_LAYER_CACHE_BYTES)
+    {
+        auto oldest_iter = m_entries.end();
+        int oldest_index = -1;
+        for (auto entries_iter = m_entries.begin(); entries_iter != m_entries.end(); ++entries_iter)
+        {
+            for (int i = 0; i < entries_iter->size(); ++i)
+            {
+                quint64 last_used = entries_iter->at(i).last_used;
+                if (last_used != m_use_count && (oldest_index < 0 || last_used < oldest_iter->at(oldest_index).last_used))
+                {
+                    oldest_iter = entries_iter;
+                    oldest_index = i;
+                }
+            }
+        }
+        if (oldest_index < 0)
+            break;
+        m_byte_count -= oldest_iter->at(oldest_index).raster_image.sizeInBytes();
+        old_entries.append(oldest_iter->at(oldest_index));
+        oldest_iter->remove(oldest_index);
+        if (oldest_iter->isEmpty())
+            m_entries.erase(oldest_iter);
+    }
+}
+
+void LayerCache::clear()
+{
+    // ensure the rasters get released outside of the lock by assigning them to this variable.
+    QMap<quint32, QVector<LayerCacheEntry>> old_entries;
+
+    QMutexLocker locker(&m_mutex);
+
+    old_entries.swap(m_entries);
+    m_byte_count = 0;
+}
+
+void LayerCache::getStatistics(QVariantMap &statistics)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qlonglong entry_count = 0;
+    for (const auto &entries : m_entries)
+        entry_count += entries.size();
+
+    statistics["layer_cache_count"] = entry_count;
+    statistics["layer_cache_bytes"] = static_cast<qlonglong>(m_byte_count);
+    statistics["layer_cache_hits"] = static_cast<qulonglong>(m_hit_count);
+    statistics["layer_cache_misses"] = static_cast<qulonglong>(m_miss_count);
+}
+
+void RenderStatistics::getStatistics(QVariantMap &statistics) const
+{
+    statistics["drawn_count"] = static_cast<qulonglong>(drawn_count.loadRelaxed());
+    statistics["culled_count"] = static_cast<qulonglong>(culled_count.loadRelaxed());
+    statistics["merged_count"] = static_cast<qulonglong>(merged_count.loadRelaxed());
+    statistics["simplified_input_vertex_count"] = static_cast<qulonglong>(simplified_input_vertex_count.loadRelaxed());
+    statistics["simplified_output_vertex_count"] = static_cast<qulonglong>(simplified_output_vertex_count.loadRelaxed());
+    statistics["rendered_frame_count"] = static_cast<qulonglong>(rendered_frame_count.loadRelaxed());
+    statistics["skipped_frame_count"] = static_cast<qulonglong>(skipped_frame_count.loadRelaxed());
+    statistics["promoted_frame_count"] = static_cast<qulonglong>(promoted_frame_count.loadRelaxed());
+    statistics["preview_frame_count"] = static_cast<qulonglong>(preview_frame_count.loadRelaxed());
+    statistics["cancelled_refinement_count"] = static_cast<qulonglong>(cancelled_refinement_count.loadRelaxed());
+}
+
+// the size (in canvas pixels) of the cells of the hit test grid.
+const float HIT_TEST_CELL_SIZE = 64.0;
+
+// the maximum number of cells covered by an entry in the hit test grid; larger entries are always tested.
+const int MAX_HIT_TEST_ENTRY_CELL_COUNT = 256;
+
+static quint64 HitTestCellKey(int x, int y)
+{
+    return (static_cast<quint64>(static_cast<quint32>(x)) << 32) | static_cast<quint32>(y);
+}
+
+HitTestIndex::HitTestIndex(const QVector<TaggedBounds> &entries)
+    : m_entries(entries)
+{
+    for (int i = 0; i < m_entries.size(); ++i)
+    {
+        const QRectF &bounds = m_entries[i].bounds;
+        int left = qFloor(bounds.left() / HIT_TEST_CELL_SIZE);
+        int top = qFloor(bounds.top() / HIT_TEST_CELL_SIZE);
+        int right = qFloor(bounds.right() / HIT_TEST_CELL_SIZE);
+        int bottom = qFloor(bounds.bottom() / HIT_TEST_CELL_SIZE);
+        if (qint64(right - left + 1) * qint64(bottom - top + 1) > MAX_HIT_TEST_ENTRY_CELL_COUNT)
+        {
+            m_large_entries.append(i);
+            continue;
+        }
+        for (int y = top; y <= bottom; ++y)
+            for (int x = left; x <= right; ++x)
+                m_cells[HitTestCellKey(x, y)].append(i);
+    }
+}
+
+// return the tags of the entries containing the point, topmost (last drawn) first, without duplicates.
+QVector<quint32> HitTestIndex::hitTest(const QPointF &point) const
+{
+    QVector<int> hit_entries;
+
+    auto cell = m_cells.constFind(HitTestCellKey(qFloor(point.x() / HIT_TEST_CELL_SIZE), qFloor(point.y() / HIT_TEST_CELL_SIZE)));
+    if (cell != m_cells.constEnd())
+    {
+        for (int i : cell.value())
+        {
+            if (m_entries[i].bounds.contains(point))
+                hit_entries.append(i);
+        }
+    }
+
+    for (int i : m_large_entries)
+    {
+        if (m_entries[i].bounds.contains(point))
+            hit_entries.append(i);
+    }
+
+    std::sort(hit_entries.begin(), hit_entries.end(), [](int a, int b) { return a > b; });
+
+    QVector<quint32> tags;
+    for (int i : hit_entries)
+    {
+        if (!tags.contains(m_entries[i].tag))
+            tags.append(m_entries[i].tag);
+    }
+    return tags;
+}
+
+/*
+ Tracks the visible rect (the intersection of the viewport and the clip) in world coordinates so that primitives
+ entirely outside of it can be skipped.
+
+ The visible rect is computed lazily and must be invalidated whenever the transform or the clip changes. Culling
+ is disabled if the transform is not invertible.
+ */
+struct CullingState
+{
+    QRectF visible_rect;
+    bool valid;
+    bool enabled;
+    unsigned int drawn_count;
+    unsigned int culled_count;
+    quint32 item_tag;  // the bounds of visible primitives are recorded in tagged_bounds when the item tag is set
+    QVector<TaggedBounds> *tagged_bounds;
+
+    CullingState() : valid(false), enabled(false), drawn_count(0), culled_count(0), item_tag(0), tagged_bounds(nullptr) { }
+
+    void invalidate() { valid = false; }
+
+    // return whether the bounds (in world coordinates) are visible and count the primitive as drawn or culled.
+    bool isVisible(QPainter *painter, const QRectF &bounds)
+    {
+        if (!valid)
+        {
+            bool invertible = false;
+            QTransform inverse_transform = painter->combinedTransform().inverted(&invertible);
+            enabled = invertible;
+            if (enabled)
+            {
+                visible_rect = inverse_transform.mapRect(QRectF(painter->viewport()));
+                if (painter->hasClipping())
+                    visible_rect &= painter->clipBoundingRect();
+            }
+            valid = true;
+        }
+        if (enabled && !visible_rect.intersects(bounds))
+        {
+            culled_count += 1;
+            return false;
+        }
+        drawn_count += 1;
+        if (item_tag && tagged_bounds)
+            tagged_bounds->append(TaggedBounds(painter->combinedTransform().mapRect(bounds), item_tag));
+        return true;
+    }
+};
+
+// return conservative bounds for a stroke with the pen, allowing for miter joins and square caps.
+static QRectF StrokeBounds(const QRectF &rect, const QPen &pen)
+{
+    float margin = pen.widthF() * (pen.joinStyle() == Qt::MiterJoin ? pen.miterLimit() : 1.0) + 1.0;
+    return rect.adjusted(-margin, -margin, margin, margin);
+}
+
+// the minimum number of elements in a path for stroke simplification to be worthwhile.
+const int MIN_SIMPLIFY_ELEMENT_COUNT = 256;
+
+static float SquaredDistanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    QPointF ab = b - a;
+    QPointF ap = p - a;
+    float length_squared = QPointF::dotProduct(ab, ab);
+    float t = length_squared > 0.0 ? qBound(0.0, QPointF::dotProduct(ap, ab) / length_squared, 1.0) : 0.0;
+    QPointF d = ap - t * ab;
+    return QPointF::dotProduct(d, d);
+}
+
+/*
+ Simplify a path made only of lines, such as a trace or a contour, using Douglas-Peucker in device space.
+
+ Removed vertices are within the tolerance (in device pixels) of the simplified path, so the stroke differs by at
+ most the tolerance. The first and last vertex of each subpath are kept, and a subpath that ends where it starts is
+ closed with closeSubpath so its closing vertex keeps its join. Returns false if the path contains curves, in which
+ case it must be stroked as is.
+ */
+static bool SimplifyLinePath(const QPainterPath &path, const QTransform &transform, float tolerance, QPainterPath &simplified_path)
+{
+    const int element_count = path.elementCount();
+
+    QVector<QPointF> device_points(element_count);
+
+    for (int i = 0; i < element_count; ++i)
+    {
+        const QPainterPath::Element &element = path.elementAt(i);
+        if (element.isCurveTo())
+            return false;
+        device_points[i] = transform.map(QPointF(element.x, element.y));
+    }
+
+    const float tolerance_squared = tolerance * tolerance;
+
+    QVector<bool> keep(element_count, false);
+    QVector<QPair<int, int>> ranges;
+
+    int subpath_start = 0;
+
+    for (int i = 1; i <= element_count; ++i)
+    {
+        if (i < element_count && !path.elementAt(i).isMoveTo())
+            continue;
+
+        keep[subpath_start] = true;
+        keep[i - 1] = true;
+        ranges.append(qMakePair(subpath_start, i - 1));
+
+        while (!ranges.isEmpty())
+        {
+            QPair<int, int> range = ranges.takeLast();
+            float max_distance_squared = 0.0;
+            int max_index = -1;
+            for (int j = range.first + 1; j < range.second; ++j)
+            {
+                float distance_squared = SquaredDistanceToSegment(device_points[j], device_points[range.first], device_points[range.second]);
+                if (distance_squared > max_distance_squared)
+                {
+                    max_distance_squared = distance_squared;
+                    max_index = j;
+                }
+            }
+            if (max_index >= 0 && max_distance_squared > tolerance_squared)
+            {
+                keep[max_index] = true;
+                ranges.append(qMakePair(range.first, max_index));
+                ranges.append(qMakePair(max_index, range.second));
+            }
+        }
+
+        subpath_start = i;
+    }
+
+    simplified_path = QPainterPath();
+    simplified_path.setFillRule(path.fillRule());
+
+    subpath_start = 0;
+
+    for (int i = 0; i < element_count; ++i)
+    {
+        if (!keep[i])
+            continue;
+        const QPainterPath::Element &element = path.elementAt(i);
+        bool is_subpath_end = i + 1 == element_count || path.elementAt(i + 1).isMoveTo();
+        if (element.isMoveTo())
+        {
+            simplified_path.moveTo(element.x, element.y);
+            subpath_start = i;
+        }
+        else if (is_subpath_end && QPointF(element.x, element.y) == QPointF(path.elementAt(subpath_start).x, path.elementAt(subpath_start).y))
+        {
+            // a closed subpath is closed again rather than ended with a line, so the closing vertex is joined.
+            simplified_path.closeSubpath();
+        }
+        else
+        {
+            simplified_path.lineTo(element.x, element.y);
+        }
+    }
+
+    return true;
+}
+
+// the maximum number of paths merged into a single stroke or fill.
+const int MAX_PATH_BATCH_COUNT = 256;
+
+/*
+ Merges consecutive strokes (or fills) with the same pen (or brush) into a single path so that they are rasterized
+ with one call.
+
+ Only paths with disjoint device bounds (including a pixel for antialiasing) are merged so that the result is
+ identical; overlapping translucent strokes would otherwise be blended once instead of twice. The batch must be
+ flushed before anything else is drawn and before the transform or clip changes (see IsPathBatchCommand).
+ */
+struct PathBatch
+{
+    enum Kind { None, Stroke, Fill };
+
+    Kind kind;
+    QPainterPath path;
+    QPen pen;
+    QBrush brush;
+    QVector<QRectF> device_bounds;
+    unsigned int merged_count;
+
+    PathBatch() : kind(None), merged_count(0) { }
+
+    bool canMerge(Kind path_kind, const QRectF &path_device_bounds) const
+    {
+        if (kind != path_kind || device_bounds.size() >= MAX_PATH_BATCH_COUNT)
+            return false;
+        for (const auto &batch_device_bounds : device_bounds)
+        {
+            if (batch_device_bounds.intersects(path_device_bounds))
+                return false;
+        }
+        return true;
+    }
+
+    void stroke(QPainter *painter, const QPainterPath &stroke_path, const QPen &stroke_pen, const QRectF &bounds)
+    {
+        QRectF path_device_bounds = painter->transform().mapRect(bounds).adjusted(-1, -1, 1, 1);
+        // dashed strokes are not merged since the dash pattern may not restart at each path.
+        if (canMerge(Stroke, path_device_bounds) && pen == stroke_pen && pen.style() == Qt::SolidLine)
+        {
+            path.addPath(stroke_path);
+            merged_count += 1;
+        }
+        else
+        {
+            flush(painter);
+            kind = Stroke;
+            path = stroke_path;
+            pen = stroke_pen;
+        }
+        device_bounds.append(path_device_bounds);
+    }
+
+    void fill(QPainter *painter, const QPainterPath &fill_path, const QBrush &fill_brush, const QRectF &bounds)
+    {
+        QRectF path_device_bounds = painter->transform().mapRect(bounds).adjusted(-1, -1, 1, 1);
+        if (canMerge(Fill, path_device_bounds) && brush == fill_brush)
+        {
+            path.addPath(fill_path);
+            merged_count += 1;
+        }
+        else
+        {
+            flush(painter);
+            kind = Fill;
+            path = fill_path;
+            brush = fill_brush;
+        }
+        device_bounds.append(path_device_bounds);
+    }
+
+    void flush(QPainter *painter)
+    {
+        if (kind == Stroke)
+            painter->strokePath(path, pen);
+        else if (kind == Fill)
+            painter->fillPath(path, brush);
+        kind = None;
+        path = QPainterPath();
+        device_bounds.clear();
+    }
+};
+
+// return whether the command can be executed without flushing the path batch.
+static bool IsPathBatchCommand(quint32 cmd)
+{
+    switch (cmd)
+    {
+        case 0x62707468: // bpth, begin path
+        case 0x63707468: // cpth, close path
+        case 0x6d6f7665: // move
+        case 0x6c696e65: // line
+        case 0x72656374: // rect
+        case 0x61726320: // arc
+        case 0x61726374: // arct, arc to
+        case 0x63756263: // cubc, cubic to
+        case 0x71756164: // quad, quadratic to
+        case 0x7374726b: // strk, stroke
+        case 0x66696c6c: // fill
+        case 0x666c7374: // flst, fill style
+        case 0x666c7367: // flsg, fill style gradient
+        case 0x73747374: // stst, stroke style
+        case 0x6c647368: // ldsh, line dash
+        case 0x6c696e77: // linw, line width
+        case 0x6c636170: // lcap, line cap
+        case 0x6c6e6a6e: // lnjn, line join
+        case 0x69746167: // itag, item tag
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct NullDeleter {template<typename T> void operator()(T*) {} };
+
+RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsSharedPtr &commands_v, const QMap<QString, QVariant> &imageMap, const RenderedTimeStamps &lastRenderedTimestamps, float display_scaling, int section_id, float devicePixelRatio, PaintBinaryContext *context)
+{
+    // decode v2 streams to v1 and paint those instead. submitted commands are already decoded and validated, so
+    // this is only for commands painted once.
+    if (IsBinaryCommandsV2(commands_v->data(), static_cast<unsigned int>(commands_v->size())))
+    {
+        CommandsSharedPtr decoded_commands = DecodeBinaryCommands(commands_v);
+        if (!decoded_commands)
+            return RenderedTimeStamps();
+        return PaintBinaryCommands(rawPainter, decoded_commands, imageMap, lastRenderedTimestamps, display_scaling, section_id, devicePixelRatio, context);
+    }
+
+    QSharedPointer<QPainter> painter(rawPainter, NullDeleter());
+
+    RenderedTimeStamps rendered_timestamps;
+
+    display_scaling = display_scaling ? display_scaling : GetDisplayScaling();
+
+    QPainterPath path;
+
+    QColor fill_color(Qt::transparent);
+    int fill_gradient = -1;
+
+    QColor line_color(Qt::black);
+    float line_width = 1.0;
+    float line_dash = 0.0;
+    Qt::PenCapStyle line_cap = Qt::SquareCap;
+    Qt::PenJoinStyle line_join = Qt::BevelJoin;
+
+    QFont text_font;
+    int text_baseline = 4; // alphabetic
+    int text_align = 1; // start
+
+    float context_scaling_x = 1.0;
+    float context_scaling_y = 1.0;
+
+    QMap<int, QGradient> gradients;
+
+    // nested commands (display lists) draw on top of what is already painted.
+    if (!context || context->depth == 0)
+        painter->fillRect(painter->viewport(), QBrush(fill_color));
+
+    QList<DrawingContextState> stack;
+
+    unsigned int command_index = 0;
+
+    const quint32 *commands = commands_v->data();
+    const unsigned int command_count = static_cast<unsigned int>(commands_v->size());
+
+    CullingState culling;
+    culling.tagged_bounds = context ? context->tagged_bounds : nullptr;
+
+    PathBatch path_batch;
+
+    unsigned int simplified_input_vertex_count = 0;
+    unsigned int simplified_output_vertex_count = 0;
+
+    extern QElapsedTimer timer;
+    extern qint64 timer_offset_ns;
+
+    while (command_index < command_count)
+    {
+        quint32 cmd_hex = read_uint32(commands, command_index);
+        quint32 cmd = (cmd_hex & 0x000000FF) << 24 |
+                      (cmd_hex & 0x0000FF00) << 8 |
+                      (cmd_hex & 0x00FF0000) >> 8 |
+                      (cmd_hex & 0xFF000000) >> 24;
+
+        // qint64 start = qint64(timer.nsecsElapsed() / 1.0E3);
+
+        if (path_batch.kind != PathBatch::None && !IsPathBatchCommand(cmd))
+            path_batch.flush(painter.data());
+
+        switch (cmd)
+        {
+            case 0x73617665:  // save
+            {
+                DrawingContextState values;
+                values.fill_color = fill_color;
+                values.fill_gradient = fill_gradient;
+                values.line_color = line_color;
+                values.line_width = line_width;
+                values.line_dash = line_dash;
+                values.line_cap = line_cap;
+                values.line_join = line_join;
+                values.text_font = text_font;
+                values.text_baseline = text_baseline;
+                values.text_align = text_align;
+                values.gradients = gradients;
+                values.path = path;
+                values.context_scaling_x = context_scaling_x;
+                values.context_scaling_y = context_scaling_y;
+                stack.push_back(values);
                 painter->save();
+                culling.invalidate();
                 break;
             }
             case 0x72657374:  // rest, restore
@@ -1789,6 +3596,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 context_scaling_x = values.context_scaling_x;
                 context_scaling_y = values.context_scaling_y;
                 painter->restore();
+                culling.invalidate();
                 break;
             }
             case 0x62707468: // bpth, begin path
@@ -1808,6 +3616,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 float a2 = read_float(commands, command_index) * display_scaling;
                 float a3 = read_float(commands, command_index) * display_scaling;
                 painter->setClipRect(a0, a1, a2, a3, Qt::IntersectClip);
+                culling.invalidate();
                 break;
             }
             case 0x7472616e: // tran, translate
@@ -1815,6 +3624,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 float a0 = read_float(commands, command_index) * display_scaling;
                 float a1 = read_float(commands, command_index) * display_scaling;
                 painter->translate(a0, a1);
+                culling.invalidate();
                 break;
             }
             case 0x7363616c: // scal, scale
@@ -1824,12 +3634,14 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 painter->scale(a0, a1);
                 context_scaling_x *= a0;
                 context_scaling_y *= a1;
+                culling.invalidate();
                 break;
             }
             case 0x726f7461: // rota, rotate
             {
                 float a0 = read_float(commands, command_index);
                 painter->rotate(a0);
+                culling.invalidate();
                 break;
             }
             case 0x6d6f7665: // move
@@ -1976,6 +3788,227 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 path.quadTo(a0, a1, a2, a3);
                 break;
             }
+            case 0x706c796c: // plyl, polyline
+            {
+                PackedArray points;
+                read_packed_array(commands, command_index, command_count, imageMap, points);
+                QPolygonF polygon = PolygonFromPackedArray(points, display_scaling);
+                QPen pen = MakeStrokePen(line_color, line_width, line_dash, line_cap, line_join, display_scaling);
+                if (polygon.size() > 1 && culling.isVisible(painter.data(), StrokeBounds(polygon.boundingRect(), pen)))
+                {
+                    painter->setPen(pen);
+                    painter->setBrush(Qt::NoBrush);
+                    painter->drawPolyline(polygon);
+                }
+                break;
+            }
+            case 0x706c7967: // plyg, polygon
+            {
+                quint32 flags = read_uint32(commands, command_index);  // 1 = fill, 2 = stroke
+                PackedArray points;
+                read_packed_array(commands, command_index, command_count, imageMap, points);
+                QPolygonF polygon = PolygonFromPackedArray(points, display_scaling);
+                QPen pen = MakeStrokePen(line_color, line_width, line_dash, line_cap, line_join, display_scaling);
+                if (polygon.size() > 1 && culling.isVisible(painter.data(), StrokeBounds(polygon.boundingRect(), pen)))
+                {
+                    QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
+                    painter->setPen((flags & 2) ? pen : QPen(Qt::NoPen));
+                    painter->setBrush((flags & 1) ? brush : QBrush(Qt::NoBrush));
+                    painter->drawPolygon(polygon);
+                }
+                break;
+            }
+            case 0x72637473: // rcts, rect batch
+            {
+                quint32 flags = read_uint32(commands, command_index);  // 1 = fill, 2 = stroke
+                PackedArray rects;
+                read_packed_array(commands, command_index, command_count, imageMap, rects);
+                PackedArray colors;
+                read_packed_array(commands, command_index, command_count, imageMap, colors);
+                unsigned int rect_count = rects.size / 4;
+                QVector<QRectF> rect_list(rect_count);
+                QRectF batch_bounds;
+                for (unsigned int i = 0; i < rect_count; ++i)
+                {
+                    rect_list[i] = QRectF(rects.floatAt(i * 4) * display_scaling, rects.floatAt(i * 4 + 1) * display_scaling, rects.floatAt(i * 4 + 2) * display_scaling, rects.floatAt(i * 4 + 3) * display_scaling);
+                    batch_bounds |= rect_list[i].normalized();
+                }
+                QPen pen = MakeStrokePen(line_color, line_width, line_dash, line_cap, line_join, display_scaling);
+                // the batch is culled (and tagged) as a whole.
+                bool is_visible = rect_count > 0 && culling.isVisible(painter.data(), (flags & 2) ? StrokeBounds(batch_bounds, pen) : batch_bounds);
+                if (is_visible && colors.size >= rect_count)
+                {
+                    // per-item colors apply to both the fill and the stroke.
+                    painter->setBrush(Qt::NoBrush);
+                    for (unsigned int i = 0; i < rect_count; ++i)
+                    {
+                        QColor color = QColor::fromRgba(colors.data[i]);
+                        if (flags & 1)
+                            painter->fillRect(rect_list[i], color);
+                        if (flags & 2)
+                        {
+                            pen.setColor(color);
+                            painter->setPen(pen);
+                            painter->drawRect(rect_list[i]);
+                        }
+                    }
+                }
+                else if (is_visible)
+                {
+                    QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
+                    painter->setPen((flags & 2) ? pen : QPen(Qt::NoPen));
+                    painter->setBrush((flags & 1) ? brush : QBrush(Qt::NoBrush));
+                    painter->drawRects(rect_list);
+                }
+                break;
+            }
+            case 0x6d726b73: // mrks, markers
+            {
+                int shape = read_uint32(commands, command_index);  // 0 = circle, 1 = cross, 2 = square
+                float marker_size = read_float(commands, command_index) * display_scaling;
+                quint32 flags = read_uint32(commands, command_index);  // 1 = fill, 2 = stroke
+                PackedArray points;
+                read_packed_array(commands, command_index, command_count, imageMap, points);
+                PackedArray colors;
+                read_packed_array(commands, command_index, command_count, imageMap, colors);
+                unsigned int point_count = points.size / 2;
+                if (point_count > 0 && marker_size > 0.0)
+                {
+                    QPen pen = MakeStrokePen(line_color, line_width, line_dash, line_cap, line_join, display_scaling);
+                    float offset = MarkerMargin(pen) + marker_size * 0.5;
+                    QPolygonF point_polygon(point_count);
+                    for (unsigned int i = 0; i < point_count; ++i)
+                        point_polygon[i] = QPointF(points.floatAt(i * 2) * display_scaling, points.floatAt(i * 2 + 1) * display_scaling);
+                    // the batch is culled (and tagged) as a whole, using the bounds of the points grown by the marker size.
+                    if (culling.isVisible(painter.data(), point_polygon.boundingRect().adjusted(-offset, -offset, offset, offset)))
+                    {
+                        // render each distinct marker once at the device scale and blit it for every point.
+                        float device_scale = qMax(0.01, std::sqrt(std::abs(painter->transform().determinant())));
+                        bool has_colors = colors.size >= point_count;
+                        QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
+                        QHash<quint32, QImage> marker_images;
+                        QImage marker_image;
+                        if (!has_colors)
+                            marker_image = MakeMarkerImage(shape, marker_size, flags & 1, flags & 2, brush, pen, device_scale);
+                        for (unsigned int i = 0; i < point_count; ++i)
+                        {
+                            QPointF point = point_polygon[i] - QPointF(offset, offset);
+                            if (has_colors)
+                            {
+                                quint32 rgba = colors.data[i];
+                                auto iter = marker_images.find(rgba);
+                                if (iter == marker_images.end())
+                                {
+                                    QColor color = QColor::fromRgba(rgba);
+                                    pen.setColor(color);
+                                    iter = marker_images.insert(rgba, MakeMarkerImage(shape, marker_size, flags & 1, flags & 2, QBrush(color), pen, device_scale));
+                                }
+                                painter->drawImage(point, iter.value());
+                            }
+                            else
+                            {
+                                painter->drawImage(point, marker_image);
+                            }
+                        }
+                    }
+                }
+                break;
+            }
+            case 0x6466646c: // dfdl, define display list
+            {
+                int display_list_id = read_uint32(commands, command_index);
+                float x = read_float(commands, command_index);
+                float y = read_float(commands, command_index);
+                float width = read_float(commands, command_index);
+                float height = read_float(commands, command_index);
+                quint32 word_count = read_uint32(commands, command_index);
+                word_count = command_index < command_count ? qMin(word_count, command_count - command_index) : 0;
+                if (context && context->display_lists)
+                {
+                    CommandsSharedPtr display_list_commands(new std::vector<quint32>(&commands[command_index], &commands[command_index] + word_count));
+                    context->display_lists->define(display_list_id, DisplayListSharedPtr(new DisplayList(display_list_commands, imageMap, QRectF(x, y, width, height))));
+                }
+                command_index += word_count;
+                break;
+            }
+            case 0x7573646c: // usdl, use display list
+            {
+                int display_list_id = read_uint32(commands, command_index);
+                float m11 = read_float(commands, command_index);
+                float m12 = read_float(commands, command_index);
+                float m21 = read_float(commands, command_index);
+                float m22 = read_float(commands, command_index);
+                float dx = read_float(commands, command_index) * display_scaling;
+                float dy = read_float(commands, command_index) * display_scaling;
+                quint32 flags = read_uint32(commands, command_index);  // 1 = draw from raster cache
+                DisplayListSharedPtr display_list;
+                if (context && context->display_lists && context->depth < MAX_DISPLAY_LIST_DEPTH)
+                    display_list = context->display_lists->get(display_list_id);
+                if (display_list && display_list->commands() && (context->blocking_allowed || !display_list->mayBlock()))
+                {
+                    PaintBinaryContext display_list_context(*context);
+                    display_list_context.depth += 1;
+                    painter->save();
+                    painter->setTransform(QTransform(m11, m12, m21, m22, dx, dy), true);
+                    if (!(flags & 1) || !PaintDisplayListRaster(painter.data(), *display_list, display_scaling, devicePixelRatio, &display_list_context))
+                        rendered_timestamps.append(PaintBinaryCommands(painter.data(), display_list->commands(), display_list->imageMap(), lastRenderedTimestamps, display_scaling, section_id, devicePixelRatio, &display_list_context));
+                    painter->restore();
+                }
+                break;
+            }
+            case 0x6c797262: // lyrb, layer begin
+            {
+                // the layer commands follow and end with the lyre command. the word count includes lyre.
+                quint32 layer_key = read_uint32(commands, command_index);
+                quint32 layer_version = read_uint32(commands, command_index);
+                float x = read_float(commands, command_index) * display_scaling;
+                float y = read_float(commands, command_index) * display_scaling;
+                float width = read_float(commands, command_index) * display_scaling;
+                float height = read_float(commands, command_index) * display_scaling;
+                quint32 word_count = read_uint32(commands, command_index);
+                word_count = command_index < command_count ? qMin(word_count, command_count - command_index) : 0;
+                // the layer is drawn with its own state, whether or not it is drawn from the cache.
+                PaintBinaryContext layer_context = context ? *context : PaintBinaryContext();
+                layer_context.depth += 1;
+                QImage raster_image;
+                QRect raster_rect;
+                QVector<TaggedBounds> raster_tagged_bounds;
+                DataProbes raster_data_probes;
+                QTransform linear_transform = RasterTransform(painter.data());
+                quint64 raster_mode = RasterMode(painter.data(), context);
+                if (!context || !context->layers || !context->layers->find(layer_key, layer_version, linear_transform, raster_mode, raster_rect, raster_image, raster_tagged_bounds, raster_data_probes))
+                {
+                    CommandsSharedPtr layer_commands(new std::vector<quint32>(&commands[command_index], &commands[command_index] + word_count));
+                    if (context && context->layers)
+                        raster_image = RasterizeBinaryCommands(painter.data(), layer_commands, imageMap, QRectF(x, y, width, height), linear_transform, display_scaling, devicePixelRatio, &layer_context, raster_rect, raster_tagged_bounds, raster_data_probes);
+                    if (!raster_image.isNull())
+                    {
+                        context->layers->insert(layer_key, layer_version, linear_transform, raster_mode, raster_rect, raster_image, raster_tagged_bounds, raster_data_probes);
+                        PaintRaster(painter.data(), raster_rect, raster_image, raster_tagged_bounds, raster_data_probes, &layer_context);
+                    }
+                    else
+                    {
+                        painter->save();
+                        rendered_timestamps.append(PaintBinaryCommands(painter.data(), layer_commands, imageMap, lastRenderedTimestamps, display_scaling, section_id, devicePixelRatio, &layer_context));
+                        painter->restore();
+                    }
+                }
+                else
+                {
+                    PaintRaster(painter.data(), raster_rect, raster_image, raster_tagged_bounds, raster_data_probes, &layer_context);
+                }
+                command_index += word_count;
+                break;
+            }
+            case 0x6c797265: // lyre, layer end
+            {
+                break;
+            }
+            case 0x69746167: // itag, item tag
+            {
+                culling.item_tag = read_uint32(commands, command_index);  // zero to stop tagging
+                break;
+            }
             case 0x73746174: // stat, statistics
             {
                 QString label = read_string(commands, command_index).simplified();
@@ -2045,6 +4078,11 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 QImageInterface image;
 
                 QRectF destination_rect(QPointF(arg4, arg5), QSizeF(arg6, arg7));
+
+                // skip converting the image if it is not visible.
+                if (!culling.isVisible(painter.data(), destination_rect))
+                    break;
+
                 float context_scaling = qMin(context_scaling_x, context_scaling_y);
                 QSize destination_size((destination_rect.size() * context_scaling).toSize());
                 QSize device_destination_size = destination_size * devicePixelRatio;
@@ -2053,7 +4091,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
 
                 if (imageMap.contains(image_key))
                 {
-                    Python_ThreadBlock thread_block;
+                    Python_ThreadBlock thread_block("paint binary image");
 
                     // Put the ndarray in image
                     PyObjectPtr ndarray_py(QVariantToPyObject(imageMap[image_key]));
@@ -2072,7 +4110,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 {
                     if (device_destination_size.width() < width * 0.75 || device_destination_size.height() < height * 0.75)
                     {
-                        image.image = image.image.scaled(device_destination_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                        image.image = image.image.scaled(device_destination_size, Qt::KeepAspectRatio, context ? context->downscale_mode : Qt::SmoothTransformation);
                     }
                     painter->drawImage(destination_rect, image.image);
                 }
@@ -2101,6 +4139,11 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                 QImageInterface image;
 
                 QRectF destination_rect(QPointF(arg4, arg5), QSizeF(arg6, arg7));
+
+                // skip scaling and color mapping the data if it is not visible.
+                if (!culling.isVisible(painter.data(), destination_rect))
+                    break;
+
                 float context_scaling = qMin(context_scaling_x, context_scaling_y);
                 QSize destination_size((destination_rect.size()* context_scaling).toSize());
                 QSize device_destination_size = destination_size * devicePixelRatio;
@@ -2109,7 +4152,7 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
 
                 if (imageMap.contains(image_key))
                 {
-                    Python_ThreadBlock thread_block;
+                    Python_ThreadBlock thread_block("paint binary data");
 
                     // Put the ndarray in image
                     PyObjectPtr ndarray_py(QVariantToPyObject(imageMap[image_key]));
@@ -2124,7 +4167,14 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                                 colormap_ndarray_py = (PyObject *)QVariantToPyObject(imageMap[color_map_image_key]);
                         }
 
-//                          PythonSupport::instance()->imageFromArray(ndarray_py, low, high, colormap_ndarray_py, &image);
+                        if (context && context->data_probes)
+                        {
+                            DataProbeSharedPtr data_probe(new DataProbe(image_id, destination_rect, painter->combinedTransform()));
+                            if (data_probe->acquire(ndarray_py))
+                                context->data_probes->append(data_probe);
+                        }
+
+                        // the array is always scaled to the destination size so that large arrays never produce a full size image.
                         PythonSupport::instance()->scaledImageFromArray(ndarray_py, device_destination_size.width(), device_destination_size.height(), context_scaling, low, high, colormap_ndarray_py, &image);
                     }
                 }
@@ -2139,23 +4189,30 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
             }
             case 0x7374726b: // strk, stroke
             {
-                QPen pen(line_color);
-                pen.setWidthF(line_width * display_scaling);
-                pen.setJoinStyle(line_join);
-                pen.setCapStyle(line_cap);
-                if (line_dash > 0.0)
+                QPen pen = MakeStrokePen(line_color, line_width, line_dash, line_cap, line_join, display_scaling);
+                QRectF bounds = StrokeBounds(path.controlPointRect(), pen);
+                if (culling.isVisible(painter.data(), bounds))
                 {
-                    QVector<qreal> dashes;
-                    dashes << line_dash * display_scaling << line_dash * display_scaling;
-                    pen.setDashPattern(dashes);
+                    QPainterPath simplified_path;
+                    if (context && context->stroke_tolerance > 0.0 && path.elementCount() >= MIN_SIMPLIFY_ELEMENT_COUNT && SimplifyLinePath(path, painter->transform(), context->stroke_tolerance, simplified_path))
+                    {
+                        simplified_input_vertex_count += path.elementCount();
+                        simplified_output_vertex_count += simplified_path.elementCount();
+                        path_batch.stroke(painter.data(), simplified_path, pen, bounds);
+                    }
+                    else
+                        path_batch.stroke(painter.data(), path, pen, bounds);
                 }
-                painter->strokePath(path, pen);
                 break;
             }
             case 0x66696c6c: // fill
             {
-                QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
-                painter->fillPath(path, brush);
+                QRectF bounds = path.controlPointRect();
+                if (culling.isVisible(painter.data(), bounds))
+                {
+                    QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
+                    path_batch.fill(painter.data(), path, brush, bounds);
+                }
                 break;
             }
             case 0x666c7374: // flst, fill style
@@ -2194,6 +4251,11 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
                     text_pos.setY(text_pos.y());
                 else if (text_baseline == 5)    // bottom
                     text_pos.setY(text_pos.y() + fm.ascent() - fm.height());
+                // allow a margin of the font height for overhanging glyphs and the stroke width.
+                float text_margin = fm.height() + line_width * display_scaling;
+                QRectF text_bounds(text_pos.x() - text_margin, text_pos.y() - fm.ascent() - text_margin, text_width + 2 * text_margin, fm.height() + 2 * text_margin);
+                if (!culling.isVisible(painter.data(), text_bounds))
+                    break;
                 if (cmd == 0x74657874) // text, fill text
                 {
                     QBrush brush = fill_gradient >= 0 ? QBrush(gradients[fill_gradient]) : QBrush(fill_color);
@@ -2219,6 +4281,8 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
             {
                 QString font_str = read_string(commands, command_index);
                 text_font = ParseFontString(font_str, display_scaling);
+                if (context)
+                    text_font.setHintingPreference(context->font_hinting);
                 break;
             }
             case 0x616c676e: // algn, text align
@@ -2362,56 +4426,178 @@ RenderedTimeStamps PaintBinaryCommands(QPainter *rawPainter, const CommandsShare
         //     qDebug() << "cmd " << QString::number(cmd, 16) << " " << (end - start);
     }
 
+    path_batch.flush(painter.data());
+
+    if (context && context->statistics)
+    {
+        context->statistics->drawn_count.fetchAndAddRelaxed(culling.drawn_count);
+        context->statistics->culled_count.fetchAndAddRelaxed(culling.culled_count);
+        context->statistics->merged_count.fetchAndAddRelaxed(path_batch.merged_count);
+        context->statistics->simplified_input_vertex_count.fetchAndAddRelaxed(simplified_input_vertex_count);
+        context->statistics->simplified_output_vertex_count.fetchAndAddRelaxed(simplified_output_vertex_count);
+    }
+
     return rendered_timestamps;
 }
 
-PyCanvasRenderTask::PyCanvasRenderTask(PyCanvas *canvas, const CanvasSectionSharedPtr &section, const DrawingCommandsSharedPtr &drawing_commands, float devicePixelRatio, const RenderedTimeStamps &rendered_timestamps)
+PyCanvasRenderTask::PyCanvasRenderTask(PyCanvas *canvas, const CanvasSectionSharedPtr &section, const DrawingCommandsSharedPtr &drawing_commands, float devicePixelRatio, const RenderedTimeStamps &rendered_timestamps, const QSharedPointer<QImage> &base_image, const QRect &base_image_rect)
     : m_canvas(canvas)
     , m_section(section)
     , m_drawing_commands(drawing_commands)
     , m_device_pixel_ratio(devicePixelRatio)
     , m_rendered_timestamps(rendered_timestamps)
+    , m_base_image(section->image_is_preview ? QSharedPointer<QImage>() : base_image)  // previews are drawn in interactive mode
+    , m_base_image_rect(base_image_rect)
+    , m_render_options(section->renderOptions())  // tasks are created with the sections mutex locked
+    , m_generation(section->m_generation)
+    , m_base_hit_test_index(section->m_hit_test_index)
+    , m_base_data_probes(section->m_data_probes)
 {
     // NOTE: this class is a QRunnable and auto deletes when the run() method completes.
 }
 
+static QPainter::RenderHints RenderHintsForMode(CanvasRenderOptions::RenderMode render_mode)
+{
+    switch (render_mode)
+    {
+        case CanvasRenderOptions::Interactive:
+            return QPainter::RenderHints();
+        case CanvasRenderOptions::Quality:
+            return DEFAULT_RENDER_HINTS | QPainter::SmoothPixmapTransform;
+        default:
+            return DEFAULT_RENDER_HINTS;
+    }
+}
+
 void PyCanvasRenderTask::run()
 {
-    RenderResult render_result(m_section);
+    RenderResult render_result(m_section, m_generation);
 
-    auto const commands = m_drawing_commands->commands();
+    auto const commands = m_drawing_commands->paintCommands();
     auto const rect = m_drawing_commands->rect();
-    auto const image_map = m_drawing_commands->imageMap();
 
     if (commands && !commands->empty() && !rect.isEmpty())
     {
-        // create the buffer image at a resolution suitable for the devicePixelRatio of the section's screen.
-        QSharedPointer<QImage> image = QSharedPointer<QImage>(new QImage(QSize(rect.width() * m_device_pixel_ratio, rect.height() * m_device_pixel_ratio), QImage::Format_ARGB32_Premultiplied));
-        image->fill(QColor(0,0,0,0));
-        QPainter painter(image.data());
-        painter.setRenderHints(DEFAULT_RENDER_HINTS);
-        // draw everything at the higher scale of the section's screen.
-        painter.scale(m_device_pixel_ratio, m_device_pixel_ratio);
-        auto new_rendered_timestamps = PaintBinaryCommands(&painter, commands, image_map, m_rendered_timestamps, 0.0, m_section->m_section_id, m_device_pixel_ratio);
-        painter.end();  // ending painter here speeds up QImage assignment below (Windows)
-        render_result.image = image;
-        render_result.image_rect = rect;
-        for (auto const &r : new_rendered_timestamps)
-        {
-            QTransform transform = r.transform;
-            transform.translate(rect.left(), rect.top());
-            transform = transform * QTransform::fromScale(1/m_device_pixel_ratio, 1/m_device_pixel_ratio);
-            render_result.rendered_timestamps.append(RenderedTimeStamp(transform, r.timestamp_ns, r.section_id));
+        QSize image_size(rect.width() * m_device_pixel_ratio, rect.height() * m_device_pixel_ratio);
+        // only the dirty rect needs to be drawn if the previous image of the section is still valid.
+        const QRect &dirty_rect = m_drawing_commands->dirtyRect();
+        bool is_partial = !dirty_rect.isEmpty() && m_base_image && m_base_image_rect == rect && m_base_image->size() == image_size;
+        // partial renders are already fast, so only full renders present a preview.
+        if (m_render_options.progressive && m_render_options.render_mode != CanvasRenderOptions::Interactive && !is_partial)
+        {
+            CanvasRenderOptions preview_render_options(m_render_options);
+            preview_render_options.render_mode = CanvasRenderOptions::Interactive;
+            RenderResult preview_render_result(m_section, m_generation);
+            preview_render_result.is_preview = true;
+            paint(preview_render_result, preview_render_options, m_device_pixel_ratio * m_render_options.preview_scale, false);
+            m_canvas->statistics().preview_frame_count.fetchAndAddRelaxed(1);
+            if (!m_canvas->presentSectionPreview(preview_render_result))
+            {
+                // newer commands are pending; finish with the preview and let them render instead of refining.
+                m_canvas->statistics().cancelled_refinement_count.fetchAndAddRelaxed(1);
+                m_canvas->continuePaintingSection(preview_render_result);
+                return;
+            }
         }
+        paint(render_result, m_render_options, m_device_pixel_ratio, is_partial);
         render_result.record_latency = true;
     }
 
     m_canvas->continuePaintingSection(render_result);
 }
 
+void PyCanvasRenderTask::paint(RenderResult &render_result, const CanvasRenderOptions &render_options, float device_pixel_ratio, bool is_partial)
+{
+    auto const commands = m_drawing_commands->paintCommands();
+    auto const rect = m_drawing_commands->rect();
+    auto const image_map = m_drawing_commands->imageMap();
+
+    // create the buffer image at a resolution suitable for the devicePixelRatio of the section's screen.
+    QSize image_size(rect.width() * device_pixel_ratio, rect.height() * device_pixel_ratio);
+    QSharedPointer<QImage> image = QSharedPointer<QImage>(is_partial ? new QImage(*m_base_image) : new QImage(image_size, QImage::Format_ARGB32_Premultiplied));
+    if (!is_partial)
+        image->fill(QColor(0,0,0,0));
+    QPainter painter(image.data());
+    painter.setRenderHints(RenderHintsForMode(render_options.render_mode));
+    // draw everything at the higher scale of the section's screen.
+    painter.scale(device_pixel_ratio, device_pixel_ratio);
+    if (is_partial)
+    {
+        // clear the dirty rect and clip to it. the culling pass skips everything outside of it.
+        QRect local_dirty_rect = m_drawing_commands->dirtyRect().intersected(rect).translated(-rect.topLeft());
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(local_dirty_rect, Qt::transparent);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter.setClipRect(local_dirty_rect);
+    }
+    PaintBinaryContext context;
+    context.display_lists = &m_canvas->displayLists();
+    context.layers = &m_canvas->layers();
+    context.statistics = &m_canvas->statistics();
+    QVector<TaggedBounds> tagged_bounds;
+    context.tagged_bounds = &tagged_bounds;
+    DataProbes data_probes;
+    context.data_probes = &data_probes;
+    context.stroke_tolerance = render_options.stroke_tolerance;
+    if (render_options.render_mode == CanvasRenderOptions::Interactive)
+    {
+        context.downscale_mode = Qt::FastTransformation;
+        context.font_hinting = QFont::PreferNoHinting;
+    }
+    context.statistics->rendered_frame_count.fetchAndAddRelaxed(1);
+    auto new_rendered_timestamps = PaintBinaryCommands(&painter, commands, image_map, m_rendered_timestamps, 0.0, m_section->m_section_id, device_pixel_ratio, &context);
+    painter.end();  // ending painter here speeds up QImage assignment below (Windows)
+    render_result.image = image;
+    render_result.image_rect = rect;
+    render_result.rendered_timestamps.clear();
+    for (auto const &r : new_rendered_timestamps)
+    {
+        QTransform transform = r.transform;
+        transform.translate(rect.left(), rect.top());
+        transform = transform * QTransform::fromScale(1/device_pixel_ratio, 1/device_pixel_ratio);
+        render_result.rendered_timestamps.append(RenderedTimeStamp(transform, r.timestamp_ns, r.section_id));
+    }
+    // convert the tagged bounds from image pixels to canvas coordinates. a partial render only draws the dirty rect,
+    // so the base entries outside of it are kept.
+    QVector<TaggedBounds> entries;
+    if (is_partial && m_base_hit_test_index)
+    {
+        QRectF dirty_rect(m_drawing_commands->dirtyRect());
+        for (auto const &entry : m_base_hit_test_index->entries())
+        {
+            if (!entry.bounds.intersects(dirty_rect))
+                entries.append(entry);
+        }
+    }
+    QTransform canvas_transform = QTransform::fromScale(1/device_pixel_ratio, 1/device_pixel_ratio) * QTransform::fromTranslate(rect.left(), rect.top());
+    for (auto const &entry : tagged_bounds)
+        entries.append(TaggedBounds(canvas_transform.mapRect(entry.bounds), entry.tag));
+    render_result.hit_test_index = entries.isEmpty() ? HitTestIndexSharedPtr() : HitTestIndexSharedPtr(new HitTestIndex(entries));
+    // likewise for the data probes, which are only created on this thread, so their transform can still be set.
+    if (is_partial)
+    {
+        QRectF dirty_rect(m_drawing_commands->dirtyRect());
+        for (auto const &data_probe : m_base_data_probes)
+        {
+            if (!data_probe->bounds().intersects(dirty_rect))
+                render_result.data_probes.append(data_probe);
+        }
+    }
+    for (auto const &data_probe : data_probes)
+    {
+        data_probe->setTransform(data_probe->transform() * canvas_transform);
+        render_result.data_probes.append(data_probe);
+    }
+}
+
 CanvasSection::CanvasSection(int section_id, float device_pixel_ratio)
     : m_section_id(section_id)
+    , m_generation(0)
+    , m_promoted(false)
+    , m_transform_reset_generation(0)
+    , m_last_display_list_generation(0)
     , m_device_pixel_ratio(device_pixel_ratio)
+    , image_is_preview(false)
     , record_latency(false)
     , m_render_task(nullptr)
     , closing(false)
@@ -2419,6 +4605,15 @@ CanvasSection::CanvasSection(int section_id, float device_pixel_ratio)
     // m_render_task auto deletes after its run method finishes, so it should not be in a scoped or shared pointer.
 }
 
+// return the options to render the section, taking promotion into account. must be called with the sections mutex locked.
+CanvasRenderOptions CanvasSection::renderOptions() const
+{
+    CanvasRenderOptions render_options(m_render_options);
+    if (m_promoted)
+        render_options.render_mode = CanvasRenderOptions::Quality;
+    return render_options;
+}
+
 /*
  The canvas widget renders low-level drawing commnds in a thread and paints the resulting bitmap.
 
@@ -2450,6 +4645,10 @@ CanvasSection::CanvasSection(int section_id, float device_pixel_ratio)
 
 PyCanvas::PyCanvas()
     : m_closing(false)
+    , m_event_coalescer(this, m_py_object)
+    , m_crosshair_enabled(false)
+    , m_crosshair_visible(false)
+    , m_data_readout_enabled(false)
     , m_pressed(false)
     , m_grab_mouse_count(0)
 {
@@ -2497,6 +4696,10 @@ PyCanvas::~PyCanvas()
  */
 void PyCanvas::continuePaintingSection(const RenderResult &render_result)
 {
+    // ensure the previous data probes get released outside of the lock by assigning them to this variable.
+    // releasing them requires the GIL.
+    DataProbes data_probes;
+
     PyCanvasRenderTask *task = nullptr;
 
     {
@@ -2510,13 +4713,19 @@ void PyCanvas::continuePaintingSection(const RenderResult &render_result)
         section->m_rendered_timestamps = render_result.rendered_timestamps;
         section->image = render_result.image;
         section->image_rect = render_result.image_rect;
+        section->image_is_preview = render_result.is_preview;
         section->record_latency = render_result.record_latency;
+        section->m_hit_test_index = render_result.hit_test_index;
+        data_probes = section->m_data_probes;
+        section->m_data_probes = render_result.data_probes;
+        if (render_result.generation >= section->m_transform_reset_generation)
+            section->m_transform.reset();
         auto pending_commands = section->m_pending_drawing_commands;
         section->m_pending_drawing_commands.reset();
         // do not start a new task if closing.
         if (!m_closing && !section->closing && pending_commands)
         {
-            task = new PyCanvasRenderTask(this, section, pending_commands, section->m_device_pixel_ratio, section->m_rendered_timestamps);
+            task = new PyCanvasRenderTask(this, section, pending_commands, section->m_device_pixel_ratio, section->m_rendered_timestamps, section->image, section->image_rect);
             section->m_render_task = task;
         }
         // note: this may be occurring during a delete, in which case even the window may not be available.
@@ -2529,15 +4738,38 @@ void PyCanvas::continuePaintingSection(const RenderResult &render_result)
         QThreadPool::globalInstance()->start(task);
 }
 
+/*
+ Present the preview image of a progressive render while the render task continues to refine it.
+
+ Returns false, without presenting the preview, if the refinement should be cancelled because newer drawing
+ commands are pending or the section is closing.
+ */
+bool PyCanvas::presentSectionPreview(const RenderResult &render_result)
+{
+    // ensure the previous data probes get released outside of the lock by assigning them to this variable.
+    DataProbes data_probes;
+
+    QMutexLocker locker(&m_sections_mutex);
+    auto section = render_result.section;
+    if (m_closing || section->closing || section->m_pending_drawing_commands)
+        return false;
+    section->image = render_result.image;
+    section->image_rect = render_result.image_rect;
+    section->image_is_preview = true;
+    section->m_hit_test_index = render_result.hit_test_index;
+    data_probes = section->m_data_probes;
+    section->m_data_probes = render_result.data_probes;
+    if (render_result.generation >= section->m_transform_reset_generation)
+        section->m_transform.reset();
+    repaintManager.requestRepaint(this);
+    return true;
+}
+
 void PyCanvas::focusInEvent(QFocusEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "focusIn", QVariantList());
-    }
+    m_event_coalescer.post("focusIn", QVariantList());
 
     QWidget::focusInEvent(event);
 }
@@ -2546,11 +4778,7 @@ void PyCanvas::focusOutEvent(QFocusEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "focusOut", QVariantList());
-    }
+    m_event_coalescer.post("focusOut", QVariantList());
 
     QWidget::focusOutEvent(event);
 }
@@ -2639,8 +4867,12 @@ struct ImageAndRect
 {
     QSharedPointer<QImage> image;
     QRect image_rect;
+    QTransform transform;
+    QColor placeholder_color;
 
     ImageAndRect(QSharedPointer<QImage> image, const QRect &image_rect) : image(image), image_rect(image_rect) { }
+    ImageAndRect(QSharedPointer<QImage> image, const QRect &image_rect, const QTransform &transform, const QColor &placeholder_color)
+    : image(image), image_rect(image_rect), transform(transform), placeholder_color(placeholder_color) { }
 };
 
 struct DrawnText
@@ -2668,15 +4900,19 @@ void PyCanvas::paintEvent(QPaintEvent *event)
 
     RenderedTimeStamps rendered_timestamps;
 
+    DrawingCommandsSharedPtr overlay_commands;
+
     {
         QMutexLocker locker(&m_sections_mutex);
 
+        overlay_commands = m_overlay_commands;
+
         auto current_time_ns = GetCurrentTime();
 
         for (auto const &section : m_sections)
         {
             if (section->image && !section->image->isNull() && section->image_rect.intersects(event->rect()))
-                imageAndRects.push_back(ImageAndRect(section->image, section->image_rect));
+                imageAndRects.push_back(ImageAndRect(section->image, section->image_rect, section->m_transform, section->m_placeholder_color));
 
             for (auto &rendered_timestamp : section->m_rendered_timestamps)
             {
@@ -2730,9 +4966,59 @@ void PyCanvas::paintEvent(QPaintEvent *event)
     QPainter painter;
     painter.begin(this);
 
-    for (auto const &imageAndRect : imageAndRects)
+    for (auto const &imageAndRect : imageAndRects)
+    {
+        if (imageAndRect.transform.isIdentity())
+        {
+            painter.drawImage(imageAndRect.image_rect, *imageAndRect.image);
+        }
+        else
+        {
+            // draw the last image with the transform (in section coordinates) until the new one is rendered.
+            const QRect &image_rect = imageAndRect.image_rect;
+            painter.save();
+            painter.setClipRect(image_rect);
+            if (imageAndRect.placeholder_color.isValid())
+                painter.fillRect(image_rect, imageAndRect.placeholder_color);
+            painter.translate(image_rect.topLeft());
+            painter.setTransform(imageAndRect.transform, true);
+            painter.drawImage(QRect(QPoint(), image_rect.size()), *imageAndRect.image);
+            painter.restore();
+        }
+    }
+
+    // the overlay is drawn directly over the section images without going through the render threads.
+    if (overlay_commands && overlay_commands->paintCommands() && !overlay_commands->paintCommands()->empty())
+    {
+        painter.save();
+        painter.setRenderHints(DEFAULT_RENDER_HINTS);
+        PaintBinaryContext context;
+        context.display_lists = &m_display_lists;
+        context.layers = &m_overlay_layers;
+        context.blocking_allowed = false;  // taking the GIL or sleeping in paintEvent would block the UI thread.
+        context.depth = 1;  // nested, so the section images are not cleared.
+        PaintBinaryCommands(&painter, overlay_commands->paintCommands(), overlay_commands->imageMap(), RenderedTimeStamps(), 0.0, 0, devicePixelRatioF(), &context);
+        painter.restore();
+    }
+
+    if (m_crosshair_enabled && m_crosshair_visible)
+    {
+        painter.save();
+        painter.setPen(QPen(m_crosshair_color, 0));
+        painter.drawLine(QPoint(m_crosshair_pos.x(), 0), QPoint(m_crosshair_pos.x(), height()));
+        painter.drawLine(QPoint(0, m_crosshair_pos.y()), QPoint(width(), m_crosshair_pos.y()));
+        painter.restore();
+    }
+
+    if (m_data_readout_enabled && !m_data_readout_text.isEmpty())
     {
-        painter.drawImage(imageAndRect.image_rect, *imageAndRect.image);
+        painter.save();
+        QFont text_font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+        painter.setFont(text_font);
+        painter.fillRect(m_data_readout_rect, Qt::white);
+        painter.setPen(Qt::black);
+        painter.drawText(m_data_readout_rect.adjusted(4, 4, -4, -4), Qt::AlignLeft | Qt::AlignVCenter, m_data_readout_text);
+        painter.restore();
     }
 
     for (auto const &drawnText : drawnTexts)
@@ -2775,6 +5061,7 @@ bool PyCanvas::event(QEvent *event)
             QPanGesture *pan_gesture = static_cast<QPanGesture *>(gesture_event->gesture(Qt::PanGesture));
             if (pan_gesture)
             {
+                m_event_coalescer.flush();
                 Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
                 float display_scaling = GetDisplayScaling();
                 if (app->dispatchPyMethod(m_py_object, "panGesture", QVariantList() << int(pan_gesture->delta().x() / display_scaling) << int(pan_gesture->delta().y() / display_scaling)).toBool())
@@ -2788,6 +5075,7 @@ bool PyCanvas::event(QEvent *event)
         } break;
         case QEvent::ToolTip:
         {
+            m_event_coalescer.flush();
             Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
             QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
             float display_scaling = GetDisplayScaling();
@@ -2803,26 +5091,23 @@ void PyCanvas::enterEvent(QEnterEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "mouseEntered", QVariantList());
-    }
+    m_event_coalescer.post("mouseEntered", QVariantList());
 }
 
 void PyCanvas::leaveEvent(QEvent *event)
 {
     Q_UNUSED(event)
 
-    if (m_py_object.isValid())
-    {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "mouseExited", QVariantList());
-    }
+    updateCrosshair(m_crosshair_pos, false);
+    updateDataReadout(m_crosshair_pos, false);
+
+    m_event_coalescer.post("mouseExited", QVariantList());
 }
 
 void PyCanvas::mousePressEvent(QMouseEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid() && event->button() == Qt::LeftButton)
     {
         float display_scaling = GetDisplayScaling();
@@ -2836,6 +5121,8 @@ void PyCanvas::mousePressEvent(QMouseEvent *event)
 
 void PyCanvas::mouseReleaseEvent(QMouseEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid() && event->button() == Qt::LeftButton)
     {
         float display_scaling = GetDisplayScaling();
@@ -2853,6 +5140,8 @@ void PyCanvas::mouseReleaseEvent(QMouseEvent *event)
 
 void PyCanvas::mouseDoubleClickEvent(QMouseEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid() && event->button() == Qt::LeftButton)
     {
         float display_scaling = GetDisplayScaling();
@@ -2864,6 +5153,10 @@ void PyCanvas::mouseDoubleClickEvent(QMouseEvent *event)
 
 void PyCanvas::mouseMoveEvent(QMouseEvent *event)
 {
+    // the crosshair and the data readout follow the mouse without a round trip through Python.
+    updateCrosshair(event->pos(), true);
+    updateDataReadout(event->pos(), true);
+
     if (m_py_object.isValid())
     {
         Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
@@ -2874,17 +5167,19 @@ void PyCanvas::mouseMoveEvent(QMouseEvent *event)
         {
             QPoint delta = event->pos() - m_grab_reference_point;
 
-            app->dispatchPyMethod(m_py_object, "grabbedMousePositionChanged", QVariantList() << int(delta.x() / display_scaling) << int(delta.y() / display_scaling) << (int)event->modifiers());
+            // deltas of consecutive grabbed moves add up since the cursor is reset to the reference point each time.
+            m_event_coalescer.accumulate("grabbedMousePositionChanged", QVariantList() << int(delta.x() / display_scaling) << int(delta.y() / display_scaling) << (int)event->modifiers(), 0, 2);
 
             QCursor::setPos(mapToGlobal(m_grab_reference_point));
             QApplication::changeOverrideCursor(Qt::BlankCursor);
         }
 
-        app->dispatchPyMethod(m_py_object, "mousePositionChanged", QVariantList() << int(event->position().x() / display_scaling) << int(event->position().y() / display_scaling) << (int)event->modifiers());
+        m_event_coalescer.queue("mousePositionChanged", QVariantList() << int(event->position().x() / display_scaling) << int(event->position().y() / display_scaling) << (int)event->modifiers());
 
         // handle case of not getting mouse released event after drag.
         if (m_pressed && !(event->buttons() & Qt::LeftButton))
         {
+            m_event_coalescer.flush();
             app->dispatchPyMethod(m_py_object, "mouseReleased", QVariantList() << int(event->position().x() / display_scaling) << int(event->position().y() / display_scaling) << (int)event->modifiers());
             m_pressed = false;
         }
@@ -2895,161 +5190,532 @@ void PyCanvas::wheelEvent(QWheelEvent *event)
 {
     if (m_py_object.isValid())
     {
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
         QWheelEvent *wheel_event = static_cast<QWheelEvent *>(event);
         float display_scaling = GetDisplayScaling();
         bool is_horizontal = abs(wheel_event->angleDelta().rx()) > abs(wheel_event->angleDelta().ry());
         QPoint delta = wheel_event->pixelDelta().isNull() ? wheel_event->angleDelta() : wheel_event->pixelDelta();
-        app->dispatchPyMethod(m_py_object, "wheelChanged", QVariantList() << int(wheel_event->position().x() / display_scaling) << int(wheel_event->position().y() / display_scaling) << int(delta.x() / display_scaling) << int(delta.y() / display_scaling) << (bool)is_horizontal);
+        m_event_coalescer.accumulate("wheelChanged", QVariantList() << int(wheel_event->position().x() / display_scaling) << int(wheel_event->position().y() / display_scaling) << int(delta.x() / display_scaling) << int(delta.y() / display_scaling) << (bool)is_horizontal, 2, 2);
+    }
+}
+
+void PyCanvas::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    if (m_py_object.isValid())
+    {
+        float display_scaling = GetDisplayScaling();
+
+        m_event_coalescer.queue("sizeChanged", QVariantList() << int(event->size().width() / display_scaling) << int(event->size().height()) / display_scaling);
+    }
+}
+
+void PyCanvas::keyPressEvent(QKeyEvent *event)
+{
+    m_event_coalescer.flush();
+
+    if (event->type() == QEvent::KeyPress)
+    {
+        if (m_py_object.isValid())
+        {
+            Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+            if (app->dispatchPyMethod(m_py_object, "keyPressed", QVariantList() << event->text() << event->key() << (int)event->modifiers()).toBool())
+            {
+                event->accept();
+                return;
+            }
+        }
+    }
+
+    QWidget::keyPressEvent(event);
+}
+
+void PyCanvas::keyReleaseEvent(QKeyEvent *event)
+{
+    m_event_coalescer.flush();
+
+    if (event->type() == QEvent::KeyRelease)
+    {
+        if (m_py_object.isValid())
+        {
+            Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+            if (app->dispatchPyMethod(m_py_object, "keyReleased", QVariantList() << event->text() << event->key() << (int)event->modifiers()).toBool())
+            {
+                event->accept();
+                return;
+            }
+        }
+    }
+
+    QWidget::keyReleaseEvent(event);
+}
+
+void PyCanvas::contextMenuEvent(QContextMenuEvent *event)
+{
+    m_event_coalescer.flush();
+
+    Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+
+    QVariantList args;
+
+    float display_scaling = GetDisplayScaling();
+
+    args.push_back(int(event->pos().x() / display_scaling));
+    args.push_back(int(event->pos().y() / display_scaling));
+    args.push_back(int(event->globalPos().x() / display_scaling));
+    args.push_back(int(event->globalPos().y() / display_scaling));
+
+    app->dispatchPyMethod(m_py_object, "contextMenuEvent", args);
+}
+
+void PyCanvas::grabMouse0(const QPoint &gp)
+{
+    unsigned grab_mouse_count = m_grab_mouse_count;
+    m_grab_mouse_count += 1;
+    if (grab_mouse_count == 0)
+    {
+        grabMouse();
+        grabKeyboard();
+        m_grab_reference_point = gp;
+        QCursor::setPos(gp);
+        QApplication::setOverrideCursor(Qt::BlankCursor);
+    }
+}
+
+void PyCanvas::releaseMouse0()
+{
+    m_grab_mouse_count -= 1;
+    if (m_grab_mouse_count == 0)
+    {
+        releaseMouse();
+        releaseKeyboard();
+        QApplication::restoreOverrideCursor();
+    }
+}
+
+void PyCanvas::setCommands(const QList<CanvasDrawingCommand> &commands)
+{
+    // deprecated.
+}
+
+/*
+ Update the drawing commands for the given section.
+
+ Section zero is used when not using individual sections.
+
+ Creates a new section if needed. Then either starts a new rendering task or stores the commands as pending.
+
+ Drawing commands identical to the last ones submitted to the section are skipped unless a display list changed
+ since then or force is true. Pass force if other state not captured in the drawing commands changed, for instance
+ the contents of an array in the image map.
+ */
+void PyCanvas::setBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands, bool force)
+{
+    submitBinarySectionCommands(section_id, drawing_commands, force, nullptr);
+}
+
+/*
+ Submit the drawing commands to the section as described in setBinarySectionCommands.
+
+ If base_commands is not null, the drawing commands are only submitted if the commands last submitted to the section
+ are still base_commands, checked under the same lock as the submission. Returns false if they changed.
+ */
+bool PyCanvas::submitBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands, bool force, const CommandsSharedPtr *base_commands)
+{
+    // ensure the originals get released outside of the lock by assigning them to these variables.
+    DrawingCommandsSharedPtr pending_drawing_commands;
+    DrawingCommandsSharedPtr last_drawing_commands;
+
+    PyCanvasRenderTask *task = nullptr;
+
+    int promote_ms = 0;
+    quint64 generation = 0;
+
+    {
+        QMutexLocker locker(&m_sections_mutex);
+
+        // this request can come in on a thread during shutdown and add a new request
+        // after the destructor has synced threading. so check if closing before proceeding.
+        if (!m_closing)
+        {
+            CanvasSectionSharedPtr section = ensureSection(section_id);
+
+            if (base_commands)
+            {
+                CommandsSharedPtr last_commands = section->m_last_drawing_commands ? section->m_last_drawing_commands->commands() : CommandsSharedPtr();
+                if (last_commands != *base_commands)
+                    return false;
+            }
+
+            // display lists are referenced by id, so a change to one changes the result of identical commands.
+            quint64 display_list_generation = m_display_lists.generation();
+
+            if (!force && section->m_last_drawing_commands && section->m_last_display_list_generation == display_list_generation && section->m_last_drawing_commands->isIdentical(*drawing_commands))
+            {
+                // a transform set since the last commands is relative to them, but the client is showing them again.
+                if (section->m_transform_reset_generation > section->m_generation && !section->m_transform.isIdentity())
+                {
+                    if (section->m_render_task)
+                    {
+                        // reset the transform once the identical commands are rendered.
+                        section->m_transform_reset_generation = section->m_generation;
+                    }
+                    else
+                    {
+                        section->m_transform.reset();
+                        repaintManager.requestRepaint(this);
+                    }
+                }
+                m_render_statistics.skipped_frame_count.fetchAndAddRelaxed(1);
+                return true;
+            }
+
+            last_drawing_commands = section->m_last_drawing_commands;
+            section->m_last_drawing_commands = drawing_commands;
+            section->m_last_display_list_generation = display_list_generation;
+            section->m_generation += 1;
+            section->m_promoted = false;
+
+            if (section->m_render_options.render_mode != CanvasRenderOptions::Quality)
+            {
+                promote_ms = section->m_render_options.promote_ms;
+                generation = section->m_generation;
+            }
+
+            pending_drawing_commands = section->m_pending_drawing_commands;
+
+            if (!section->m_render_task && !section->closing)
+            {
+                task = new PyCanvasRenderTask(this, section, drawing_commands, section->m_device_pixel_ratio, section->m_rendered_timestamps, section->image, section->image_rect);
+                section->m_render_task = task;
+            }
+            else if (pending_drawing_commands && !drawing_commands->dirtyRect().isEmpty())
+            {
+                // the pending drawing commands are dropped, so the dirty rect must also include their changes.
+                const QRect &pending_dirty_rect = pending_drawing_commands->dirtyRect();
+                QRect dirty_rect = pending_dirty_rect.isEmpty() ? QRect() : pending_dirty_rect.united(drawing_commands->dirtyRect());
+                section->m_pending_drawing_commands.reset(new DrawingCommands(*drawing_commands, dirty_rect));
+            }
+            else
+            {
+                section->m_pending_drawing_commands = drawing_commands;
+            }
+        }
+    }
+
+    // launch the task outside of the mutex.
+    if (task)
+        QThreadPool::globalInstance()->start(task);
+
+    // the promotion timer must run on the main thread; it is ignored if other commands are submitted in the meantime.
+    if (promote_ms > 0)
+    {
+        QMetaObject::invokeMethod(this, [this, section_id, generation, promote_ms]() {
+            QTimer::singleShot(promote_ms, this, [this, section_id, generation]() { promoteSection(section_id, generation); });
+        }, Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
+// render the last drawing commands of the section in quality mode if none were submitted since the generation.
+void PyCanvas::promoteSection(int section_id, quint64 generation)
+{
+    DrawingCommandsSharedPtr pending_drawing_commands;
+
+    PyCanvasRenderTask *task = nullptr;
+
+    {
+        QMutexLocker locker(&m_sections_mutex);
+
+        if (m_closing || !m_sections.contains(section_id))
+            return;
+
+        CanvasSectionSharedPtr section = m_sections[section_id];
+
+        if (section->closing || section->m_generation != generation || section->m_promoted || !section->m_last_drawing_commands)
+            return;
+
+        if (section->m_render_options.render_mode == CanvasRenderOptions::Quality)
+            return;
+
+        section->m_promoted = true;
+        m_render_statistics.promoted_frame_count.fetchAndAddRelaxed(1);
+
+        // render the entire section since the previous image was rendered in a lower quality mode.
+        const DrawingCommandsSharedPtr &last_drawing_commands = section->m_last_drawing_commands;
+        DrawingCommandsSharedPtr drawing_commands(new DrawingCommands(*last_drawing_commands, QRect()));
+
+        pending_drawing_commands = section->m_pending_drawing_commands;
+
+        if (!section->m_render_task)
+        {
+            task = new PyCanvasRenderTask(this, section, drawing_commands, section->m_device_pixel_ratio, section->m_rendered_timestamps, section->image, section->image_rect);
+            section->m_render_task = task;
+        }
+        else
+        {
+            section->m_pending_drawing_commands = drawing_commands;
+        }
+    }
+
+    // launch the task outside of the mutex.
+    if (task)
+        QThreadPool::globalInstance()->start(task);
+}
+
+// return the section, creating it if required. must be called with the sections mutex locked.
+CanvasSectionSharedPtr PyCanvas::ensureSection(int section_id)
+{
+    CanvasSectionSharedPtr section;
+
+    if (m_sections.contains(section_id))
+    {
+        section = m_sections[section_id];
+    }
+    else
+    {
+        auto screen = this->screen();
+        auto device_pixel_ratio = screen ? screen->devicePixelRatio() : 1.0;  // m_screen may be nullptr in earlier versions of Qt
+        section.reset(new CanvasSection(section_id, device_pixel_ratio));
+        m_sections[section_id] = section;
+    }
+
+    return section;
+}
+
+/*
+ Set the tolerance (in device pixels) used to simplify long line strokes in the section. Zero disables it.
+
+ The tolerance applies to renders started after this call.
+ */
+void PyCanvas::setSectionStrokeSimplification(int section_id, float tolerance)
+{
+    QMutexLocker locker(&m_sections_mutex);
+
+    if (!m_closing)
+        ensureSection(section_id)->m_render_options.stroke_tolerance = qMax(tolerance, 0.0f);
+}
+
+/*
+ Set the render mode of the section and the idle time (in milliseconds) after which it is promoted to quality mode.
+
+ The render mode applies to renders started after this call.
+ */
+void PyCanvas::setSectionRenderMode(int section_id, CanvasRenderOptions::RenderMode render_mode, int promote_ms)
+{
+    QMutexLocker locker(&m_sections_mutex);
+
+    if (!m_closing)
+    {
+        CanvasRenderOptions &render_options = ensureSection(section_id)->m_render_options;
+        render_options.render_mode = render_mode;
+        render_options.promote_ms = qMax(promote_ms, 0);
     }
 }
 
-void PyCanvas::resizeEvent(QResizeEvent *event)
+/*
+ Set the drawing commands painted over the section images. Pass empty commands to clear the overlay.
+
+ The overlay is painted on the UI thread in paintEvent, so it should be small, for instance a selection rectangle or a
+ hover highlight. It is in canvas coordinates. It cannot use Python, so it must not draw images, data, or arrays from
+ the image map; display lists that do are skipped.
+ */
+void PyCanvas::setOverlayCommands(const DrawingCommandsSharedPtr &drawing_commands)
+{
+    // ensure the original gets released outside of the lock by assigning it to this variable.
+    DrawingCommandsSharedPtr overlay_commands;
+
+    {
+        QMutexLocker locker(&m_sections_mutex);
+
+        if (m_closing)
+            return;
+
+        overlay_commands = m_overlay_commands;
+        m_overlay_commands = drawing_commands;
+    }
+
+    repaintManager.requestRepaint(this);
+}
+
+// enable a crosshair that follows the mouse. must be called on the UI thread.
+void PyCanvas::setCrosshair(bool enabled, const QColor &color)
+{
+    m_crosshair_enabled = enabled;
+    m_crosshair_color = color;
+    update();
+}
+
+// move or hide the crosshair, repainting only the lines that changed.
+void PyCanvas::updateCrosshair(const QPoint &pos, bool visible)
 {
-    QWidget::resizeEvent(event);
-    if (m_py_object.isValid())
-    {
-        float display_scaling = GetDisplayScaling();
+    if (!m_crosshair_enabled)
+        return;
 
-        Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-        app->dispatchPyMethod(m_py_object, "sizeChanged", QVariantList() << int(event->size().width() / display_scaling) << int(event->size().height()) / display_scaling);
+    if (m_crosshair_visible)
+    {
+        update(QRect(m_crosshair_pos.x() - 1, 0, 3, height()));
+        update(QRect(0, m_crosshair_pos.y() - 1, width(), 3));
     }
-}
 
-void PyCanvas::keyPressEvent(QKeyEvent *event)
-{
-    if (event->type() == QEvent::KeyPress)
+    m_crosshair_pos = pos;
+    m_crosshair_visible = visible;
+
+    if (m_crosshair_visible)
     {
-        if (m_py_object.isValid())
-        {
-            Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-            if (app->dispatchPyMethod(m_py_object, "keyPressed", QVariantList() << event->text() << event->key() << (int)event->modifiers()).toBool())
-            {
-                event->accept();
-                return;
-            }
-        }
+        update(QRect(m_crosshair_pos.x() - 1, 0, 3, height()));
+        update(QRect(0, m_crosshair_pos.y() - 1, width(), 3));
     }
+}
 
-    QWidget::keyPressEvent(event);
+// show the raw data value under the mouse. must be called on the UI thread.
+void PyCanvas::setDataReadout(bool enabled)
+{
+    m_data_readout_enabled = enabled;
+    m_data_readout_text.clear();
+    update(m_data_readout_rect);
 }
 
-void PyCanvas::keyReleaseEvent(QKeyEvent *event)
+// update the data readout for the mouse position, repainting only the readout.
+void PyCanvas::updateDataReadout(const QPoint &pos, bool visible)
 {
-    if (event->type() == QEvent::KeyRelease)
+    if (!m_data_readout_enabled)
+        return;
+
+    update(m_data_readout_rect);
+
+    QVariantMap result;
+    if (visible && probeData(pos, result))
     {
-        if (m_py_object.isValid())
-        {
-            Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
-            if (app->dispatchPyMethod(m_py_object, "keyReleased", QVariantList() << event->text() << event->key() << (int)event->modifiers()).toBool())
-            {
-                event->accept();
-                return;
-            }
-        }
+        m_data_readout_text = QString("%1, %2: %3").arg(result["x"].toLongLong()).arg(result["y"].toLongLong()).arg(result["value"].toString());
+        QFontMetrics fm(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        m_data_readout_rect = QRect(pos + QPoint(12, 12), QSize(fm.horizontalAdvance(m_data_readout_text) + 8, fm.height() + 8));
+        update(m_data_readout_rect);
+    }
+    else
+    {
+        m_data_readout_text.clear();
     }
-
-    QWidget::keyReleaseEvent(event);
 }
 
-void PyCanvas::contextMenuEvent(QContextMenuEvent *event)
-{
-    Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
+/*
+ Set a transform to apply to the last image of the section, for instance to pan or zoom, until it is rendered again.
 
-    QVariantList args;
+ The transform is in section coordinates and is relative to the most recently submitted drawing commands. It is reset
+ once drawing commands submitted after this call are rendered, so the client should submit the drawing commands for
+ the transformed view as usual. Exposed areas are filled with the placeholder color, if valid.
+ */
+void PyCanvas::setSectionTransform(int section_id, const QTransform &transform, const QColor &placeholder_color)
+{
+    {
+        QMutexLocker locker(&m_sections_mutex);
 
-    float display_scaling = GetDisplayScaling();
+        if (m_closing)
+            return;
 
-    args.push_back(int(event->pos().x() / display_scaling));
-    args.push_back(int(event->pos().y() / display_scaling));
-    args.push_back(int(event->globalPos().x() / display_scaling));
-    args.push_back(int(event->globalPos().y() / display_scaling));
+        CanvasSectionSharedPtr section = ensureSection(section_id);
+        section->m_transform = transform;
+        section->m_transform_reset_generation = section->m_generation + 1;
+        section->m_placeholder_color = placeholder_color;
+    }
 
-    app->dispatchPyMethod(m_py_object, "contextMenuEvent", args);
+    repaintManager.requestRepaint(this);
 }
 
-void PyCanvas::grabMouse0(const QPoint &gp)
+/*
+ Set whether full renders of the section present a fast preview before the final image.
+
+ The preview scale (0 to 1) reduces the resolution of the preview relative to the device pixel ratio.
+ */
+void PyCanvas::setSectionProgressive(int section_id, bool progressive, float preview_scale)
 {
-    unsigned grab_mouse_count = m_grab_mouse_count;
-    m_grab_mouse_count += 1;
-    if (grab_mouse_count == 0)
+    QMutexLocker locker(&m_sections_mutex);
+
+    if (!m_closing)
     {
-        grabMouse();
-        grabKeyboard();
-        m_grab_reference_point = gp;
-        QCursor::setPos(gp);
-        QApplication::setOverrideCursor(Qt::BlankCursor);
+        CanvasRenderOptions &render_options = ensureSection(section_id)->m_render_options;
+        render_options.progressive = progressive;
+        render_options.preview_scale = qBound(0.1f, preview_scale, 1.0f);
     }
 }
 
-void PyCanvas::releaseMouse0()
+/*
+ Apply patches to the commands.
+
+ The patches are a sequence of (offset, remove count, insert count, inserted words) in 32-bit words. The offsets
+ refer to the commands and must be increasing and non-overlapping. Returns false if the patches are invalid.
+ */
+bool ApplyBinaryCommandsPatches(const std::vector<quint32> &commands, const quint32 *patches, unsigned int patch_word_count, std::vector<quint32> &patched_commands)
 {
-    m_grab_mouse_count -= 1;
-    if (m_grab_mouse_count == 0)
+    const unsigned int command_count = static_cast<unsigned int>(commands.size());
+
+    patched_commands.clear();
+    patched_commands.reserve(command_count);
+
+    unsigned int command_index = 0;
+    unsigned int patch_index = 0;
+
+    while (patch_index < patch_word_count)
     {
-        releaseMouse();
-        releaseKeyboard();
-        QApplication::restoreOverrideCursor();
+        if (patch_word_count - patch_index < 3)
+            return false;
+
+        quint32 offset = patches[patch_index++];
+        quint32 remove_count = patches[patch_index++];
+        quint32 insert_count = patches[patch_index++];
+
+        if (offset < command_index || offset > command_count || remove_count > command_count - offset || insert_count > patch_word_count - patch_index)
+            return false;
+
+        patched_commands.insert(patched_commands.end(), commands.begin() + command_index, commands.begin() + offset);
+        patched_commands.insert(patched_commands.end(), patches + patch_index, patches + patch_index + insert_count);
+
+        patch_index += insert_count;
+        command_index = offset + remove_count;
     }
-}
 
-void PyCanvas::setCommands(const QList<CanvasDrawingCommand> &commands)
-{
-    // deprecated.
+    patched_commands.insert(patched_commands.end(), commands.begin() + command_index, commands.end());
+
+    return true;
 }
 
 /*
- Update the drawing commands for the given section.
-
- Section zero is used when not using individual sections.
+ Render the section from the last drawing commands submitted to it with patches applied.
 
- Creates a new section if needed. Then either starts a new rendering task or stores the commands as pending.
+ The patches are described in ApplyBinaryCommandsPatches and apply to the last submitted command buffer. Patching
+ and submitting are atomic with respect to other submissions to the section. Returns false if the patches are
+ invalid, in which case nothing is submitted.
  */
-void PyCanvas::setBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands)
+bool PyCanvas::patchBinarySectionCommands(int section_id, const quint32 *patches, unsigned int patch_word_count, const QRect &rect, const QMap<QString, QVariant> &image_map, const QRect &dirty_rect)
 {
-    // ensure the original gets released outside of the lock by assigning it to this variable.
-    DrawingCommandsSharedPtr pending_drawing_commands;
-
-    PyCanvasRenderTask *task = nullptr;
-
+    while (true)
     {
-        QMutexLocker locker(&m_sections_mutex);
+        CommandsSharedPtr last_commands;
 
-        // this request can come in on a thread during shutdown and add a new request
-        // after the destructor has synced threading. so check if closing before proceeding.
-        if (!m_closing)
         {
-            CanvasSectionSharedPtr section;
+            QMutexLocker locker(&m_sections_mutex);
 
-            if (m_sections.contains(section_id))
-            {
-                section = m_sections[section_id];
-            }
-            else
-            {
-                auto screen = this->screen();
-                auto device_pixel_ratio = screen ? screen->devicePixelRatio() : 1.0;  // m_screen may be nullptr in earlier versions of Qt
-                section.reset(new CanvasSection(section_id, device_pixel_ratio));
-                m_sections[section_id] = section;
-            }
+            if (m_sections.contains(section_id) && m_sections[section_id]->m_last_drawing_commands)
+                last_commands = m_sections[section_id]->m_last_drawing_commands->commands();
+        }
 
-            pending_drawing_commands = section->m_pending_drawing_commands;
+        const std::vector<quint32> no_commands;
 
-            if (!section->m_render_task && !section->closing)
-            {
-                task = new PyCanvasRenderTask(this, section, drawing_commands, section->m_device_pixel_ratio, section->m_rendered_timestamps);
-                section->m_render_task = task;
-            }
-            else
-            {
-                section->m_pending_drawing_commands = drawing_commands;
-            }
-        }
-    }
+        CommandsSharedPtr commands(new std::vector<quint32>());
 
-    // launch the task outside of the mutex.
-    if (task)
-        QThreadPool::globalInstance()->start(task);
+        if (!ApplyBinaryCommandsPatches(last_commands ? *last_commands : no_commands, patches, patch_word_count, *commands))
+            return false;
+
+        DrawingCommandsSharedPtr drawing_commands(new DrawingCommands(commands, rect, image_map, dirty_rect));
+
+        if (!drawing_commands->isValid())
+            return false;
+
+        // commands submitted by another thread since the base was read must not be overwritten by a patch
+        // applied to the older base; apply the patches again to the new base instead.
+        if (submitBinarySectionCommands(section_id, drawing_commands, false, &last_commands))
+            return true;
+    }
 }
 
 void PyCanvas::removeSection(int section_id)
@@ -3067,7 +5733,7 @@ void PyCanvas::removeSection(int section_id)
         // when closing a section, it may need to render to Python and this method
         // may be called from Python. so allow Python threads in the wait-loop.
         {
-            Python_ThreadAllow thread_allow;
+            Python_ThreadAllow thread_allow("remove section");
             m_sections_mutex.unlock();
             QThread::msleep(1);
             m_sections_mutex.lock();
@@ -3077,8 +5743,95 @@ void PyCanvas::removeSection(int section_id)
     m_sections.remove(section_id);
 }
 
+/*
+ Map a point in canvas coordinates to the last image of the section, through the inverse of the section transform with
+ which the image is painted. Returns false if the image is not painted at the point.
+ */
+static bool MapToSectionImage(const CanvasSection &section, const QPointF &point, QPointF &image_point)
+{
+    if (!section.image_rect.contains(point.toPoint()))
+        return false;
+    if (section.m_transform.isIdentity())
+    {
+        image_point = point;
+        return true;
+    }
+    bool invertible = false;
+    QTransform inverse_transform = section.m_transform.inverted(&invertible);
+    if (!invertible)
+        return false;
+    QPointF origin = section.image_rect.topLeft();
+    image_point = inverse_transform.map(point - origin) + origin;
+    return section.image_rect.contains(image_point.toPoint());
+}
+
+/*
+ Return the item tags of the primitives drawn at the point (in canvas coordinates), topmost first.
+
+ Sections are tested in the order they are painted, taking into account the transforms of their images.
+ */
+QVector<quint32> PyCanvas::hitTest(const QPointF &point)
+{
+    QVector<quint32> tags;
+
+    QMutexLocker locker(&m_sections_mutex);
+
+    for (auto const &section : m_sections)
+    {
+        QPointF image_point;
+        if (section->m_hit_test_index && MapToSectionImage(*section, point, image_point))
+        {
+            // sections painted later are on top.
+            QVector<quint32> section_tags = section->m_hit_test_index->hitTest(image_point);
+            section_tags.append(tags);
+            tags = section_tags;
+        }
+    }
+
+    return tags;
+}
+
+/*
+ Read the raw value of the topmost data drawn at the point (in canvas coordinates).
+
+ The result contains the image id of the data command, the x and y pixel of the array, and the value. Returns false
+ if no data with a supported format (two dimensional, native byte order, real) is drawn at the point.
+ */
+bool PyCanvas::probeData(const QPointF &point, QVariantMap &result)
+{
+    QMutexLocker locker(&m_sections_mutex);
+
+    for (auto section = m_sections.constEnd(); section != m_sections.constBegin(); )
+    {
+        --section;
+        QPointF image_point;
+        if (!MapToSectionImage(*section.value(), point, image_point))
+            continue;
+        const DataProbes &data_probes = section.value()->m_data_probes;
+        for (int i = data_probes.size() - 1; i >= 0; --i)
+        {
+            if (data_probes[i]->probe(image_point, result))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+QVariantMap PyCanvas::renderStatistics()
+{
+    QVariantMap statistics;
+
+    m_layers.getStatistics(statistics);
+    m_render_statistics.getStatistics(statistics);
+
+    return statistics;
+}
+
 void PyCanvas::dragEnterEvent(QDragEnterEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid())
     {
         Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
@@ -3110,6 +5863,8 @@ void PyCanvas::dragEnterEvent(QDragEnterEvent *event)
 
 void PyCanvas::dragLeaveEvent(QDragLeaveEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid())
     {
         Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
@@ -3131,6 +5886,8 @@ void PyCanvas::dragLeaveEvent(QDragLeaveEvent *event)
 
 void PyCanvas::dragMoveEvent(QDragMoveEvent *event)
 {
+    m_event_coalescer.flush();
+
     if (m_py_object.isValid())
     {
         Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
@@ -3163,6 +5920,8 @@ void PyCanvas::dragMoveEvent(QDragMoveEvent *event)
 
 void PyCanvas::dropEvent(QDropEvent *event)
 {
+    m_event_coalescer.flush();
+
     QWidget::dropEvent(event);
     if (m_py_object.isValid())
     {
@@ -3798,6 +6557,11 @@ int ItemModel::columnCount(const QModelIndex &parent) const
 int ItemModel::rowCount(const QModelIndex &parent) const
 {
     Q_ASSERT(QApplication::instance()->thread() == QThread::currentThread());
+
+    auto cached_children = m_cached_children.constFind((quint32)parent.internalId());
+    if (cached_children != m_cached_children.constEnd())
+        return cached_children->size();
+
     Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
 
     return app->dispatchPyMethod(m_py_object, "itemCount", QVariantList() << parent.internalId()).toUInt();
@@ -3823,6 +6587,14 @@ QModelIndex ItemModel::index(int row, int column, const QModelIndex &parent) con
     if (parent.isValid() && parent.column() != 0)
         return QModelIndex();
 
+    auto cached_children = m_cached_children.constFind((quint32)parent.internalId());
+    if (cached_children != m_cached_children.constEnd())
+    {
+        if (row >= 0 && row < cached_children->size())
+            return createIndex(row, 0, cached_children->at(row));
+        return QModelIndex();
+    }
+
     Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
 
     int item_id = app->dispatchPyMethod(m_py_object, "itemId", QVariantList() << row << parent.internalId()).toUInt();
@@ -3834,6 +6606,17 @@ QModelIndex ItemModel::index(int row, int column, const QModelIndex &parent) con
 
 QModelIndex ItemModel::parent(const QModelIndex &index) const
 {
+    auto cached_item = m_cached_items.constFind((quint32)index.internalId());
+    if (cached_item != m_cached_items.constEnd())
+    {
+        quint32 parent_item_id = cached_item->parent_item_id;
+        if (parent_item_id == 0)
+            return QModelIndex();
+        auto cached_parent_item = m_cached_items.constFind(parent_item_id);
+        if (cached_parent_item != m_cached_items.constEnd())
+            return createIndex(cached_parent_item->row, 0, parent_item_id);
+    }
+
     Application *app = dynamic_cast<Application *>(QCoreApplication::instance());
 
     QVariantList result = app->dispatchPyMethod(m_py_object, "itemParent", QVariantList() << index.row() << index.internalId()).toList();
@@ -3876,6 +6659,23 @@ QVariant ItemModel::data(const QModelIndex &index, int role) const
         {
             if (index.column() == 0)
             {
+                // values of cached items invalidated by dataChanged are fetched once and cached again.
+                auto cached_item = m_cached_items.find((quint32)index.internalId());
+                if (cached_item != m_cached_items.end())
+                {
+                    bool is_display = role == Qt::DisplayRole;
+                    if (is_display ? cached_item->has_display_value : cached_item->has_edit_value)
+                        return is_display ? cached_item->display_value : cached_item->edit_value;
+                    QVariant value = app->dispatchPyMethod(m_py_object, "itemValue", QVariantList() << role_name << index.row() << index.internalId());
+                    // dispatching may change the cache.
+                    cached_item = m_cached_items.find((quint32)index.internalId());
+                    if (cached_item != m_cached_items.end())
+                    {
+                        (is_display ? cached_item->display_value : cached_item->edit_value) = value;
+                        (is_display ? cached_item->has_display_value : cached_item->has_edit_value) = true;
+                    }
+                    return value;
+                }
                 return app->dispatchPyMethod(m_py_object, "itemValue", QVariantList() << role_name << index.row() << index.internalId());
             }
         } break;
@@ -3903,7 +6703,16 @@ bool ItemModel::setData(const QModelIndex &index, const QVariant &value, int rol
     bool result = app->dispatchPyMethod(m_py_object, "itemSetData", QVariantList() << row << parent_row << parent_id << value).toBool();
 
     if (result)
+    {
+        auto cached_item = m_cached_items.find((quint32)index.internalId());
+        if (cached_item != m_cached_items.end())
+        {
+            cached_item->has_display_value = false;
+            cached_item->has_edit_value = false;
+        }
+
         Q_EMIT dataChanged(index, index);
+    }
 
     return result;
 }
@@ -4000,6 +6809,9 @@ void ItemModel::beginInsertRowsInParent(int first_row, int last_row, int parent_
     Q_ASSERT(QApplication::instance()->thread() == QThread::currentThread());
     QModelIndex parent = parent_row < 0 ? QModelIndex() : createIndex(parent_row, 0, (quint32)parent_item_id);
 
+    // the rows of the following items change. their children remain valid.
+    removeCachedChildren(parent_row < 0 ? 0 : parent_item_id, false);
+
     beginInsertRows(parent, first_row, last_row);
 }
 
@@ -4008,6 +6820,17 @@ void ItemModel::beginRemoveRowsInParent(int first_row, int last_row, int parent_
     Q_ASSERT(QApplication::instance()->thread() == QThread::currentThread());
     QModelIndex parent = parent_row < 0 ? QModelIndex() : createIndex(parent_row, 0, (quint32)parent_item_id);
 
+    // the removed items and their descendants are removed since Python may reuse their ids.
+    quint32 cached_parent_item_id = parent_row < 0 ? 0 : parent_item_id;
+    auto cached_children = m_cached_children.constFind(cached_parent_item_id);
+    if (cached_children != m_cached_children.constEnd())
+    {
+        QVector<quint32> children = *cached_children;
+        for (int row = qMax(first_row, 0); row <= last_row && row < children.size(); ++row)
+            removeCachedChildren(children[row], true);
+    }
+    removeCachedChildren(cached_parent_item_id, false);
+
     beginRemoveRows(parent, first_row, last_row);
 }
 
@@ -4038,7 +6861,16 @@ void ItemModel::dataChangedInParent(int row, int parent_row, int parent_item_id)
     Q_ASSERT(QApplication::instance()->thread() == QThread::currentThread());
     QModelIndex parent = parent_row < 0 ? QModelIndex() : createIndex(parent_row, 0, (quint32)parent_item_id);
 
-    Q_EMIT dataChanged(index(row, 0, parent), index(row, 0, parent));
+    QModelIndex item_index = index(row, 0, parent);
+
+    auto cached_item = m_cached_items.find((quint32)item_index.internalId());
+    if (item_index.isValid() && cached_item != m_cached_items.end())
+    {
+        cached_item->has_display_value = false;
+        cached_item->has_edit_value = false;
+    }
+
+    Q_EMIT dataChanged(item_index, item_index);
 }
 
 QModelIndex ItemModel::indexInParent(int row, int parent_row, int parent_item_id)
@@ -4049,6 +6881,58 @@ QModelIndex ItemModel::indexInParent(int row, int parent_row, int parent_item_id
     return index(row, 0, parent);
 }
 
+/*
+ Cache the children of the parent item so that Qt's queries for them are answered without calling Python.
+
+ Each row is a list of item id, display value and optional edit value (defaulting to the display value); pass a
+ parent item id of 0 for the top level items. The rows must match the current model, so call this after the
+ corresponding end insert/remove rows notification. Inserting or removing rows drops the cached children of the
+ parent and data changes invalidate the cached values, which are then fetched from Python once.
+ */
+void ItemModel::setRows(quint32 parent_item_id, const QVariantList &rows)
+{
+    Q_ASSERT(QApplication::instance()->thread() == QThread::currentThread());
+
+    removeCachedChildren(parent_item_id, false);
+
+    QVector<quint32> children;
+    children.reserve(rows.size());
+
+    for (int row = 0; row < rows.size(); ++row)
+    {
+        QVariantList values = rows[row].toList();
+        quint32 item_id = values.value(0).toUInt();
+        CachedItem cached_item;
+        cached_item.parent_item_id = parent_item_id;
+        cached_item.row = row;
+        cached_item.display_value = values.value(1);
+        cached_item.edit_value = values.size() > 2 ? values[2] : cached_item.display_value;
+        cached_item.has_display_value = values.size() > 1;
+        cached_item.has_edit_value = values.size() > 1;
+        m_cached_items[item_id] = cached_item;
+        children.append(item_id);
+    }
+
+    m_cached_children[parent_item_id] = children;
+}
+
+void ItemModel::removeCachedChildren(quint32 parent_item_id, bool recursive)
+{
+    auto cached_children = m_cached_children.find(parent_item_id);
+    if (cached_children == m_cached_children.end())
+        return;
+
+    QVector<quint32> children = *cached_children;
+    m_cached_children.erase(cached_children);
+
+    for (auto item_id : children)
+    {
+        m_cached_items.remove(item_id);
+        if (recursive)
+            removeCachedChildren(item_id, true);
+    }
+}
+
 // -----------------------------------------------------------
 // PyDrawingContext
 // -----------------------------------------------------------
@@ -4069,6 +6953,50 @@ void PyDrawingContext::paintCommands(const QList<CanvasDrawingCommand> &commands
 
 PyStyledItemDelegate::PyStyledItemDelegate()
 {
+    // cost is in KB, so this limits the rasterized items to about 64 MB.
+    m_item_pixmaps.setMaxCost(64 * 1024);
+}
+
+/*
+ Supply binary commands to draw the item instead of dispatching paint to Python.
+
+ The commands are drawn relative to the item rect and rasterized into a pixmap which is reused until the version,
+ the item size, or the device pixel ratio changes. Supplying the same version again is ignored.
+ */
+void PyStyledItemDelegate::setItemCommands(quint32 item_id, qint64 version, const CommandsSharedPtr &commands, const QMap<QString, QVariant> &image_map)
+{
+    auto item_commands = m_item_commands.find(item_id);
+    if (item_commands != m_item_commands.end() && item_commands->version == version)
+        return;
+
+    ItemCommands new_item_commands;
+    new_item_commands.version = version;
+    new_item_commands.commands = commands;
+    new_item_commands.image_map = image_map;
+    m_item_commands[item_id] = new_item_commands;
+
+    m_item_pixmaps.remove(item_id);
+
+    if (m_item_view)
+        m_item_view->viewport()->update();
+}
+
+void PyStyledItemDelegate::clearItemCommands(quint32 item_id)
+{
+    m_item_commands.remove(item_id);
+    m_item_pixmaps.remove(item_id);
+
+    if (m_item_view)
+        m_item_view->viewport()->update();
+}
+
+void PyStyledItemDelegate::clearAllItemCommands()
+{
+    m_item_commands.clear();
+    m_item_pixmaps.clear();
+
+    if (m_item_view)
+        m_item_view->viewport()->update();
 }
 
 void PyStyledItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
@@ -4079,10 +7007,41 @@ void PyStyledItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
     QStyle *style = widget ? widget->style() : QApplication::style();
     style->drawControl(QStyle::CE_ItemViewItem, &option_copy, painter, widget);
 
+    if (!m_item_view)
+        m_item_view = qobject_cast<QAbstractItemView *>(const_cast<QWidget *>(widget));
+
     painter->save();
     painter->setRenderHints(DEFAULT_RENDER_HINTS | QPainter::SmoothPixmapTransform);
 
-    if (m_py_object.isValid())
+    auto item_commands = m_item_commands.constFind((quint32)index.internalId());
+    if (item_commands != m_item_commands.constEnd())
+    {
+        qreal device_pixel_ratio = painter->device()->devicePixelRatioF();
+        QSize size = option.rect.size();
+        ItemPixmap *item_pixmap = m_item_pixmaps.object((quint32)index.internalId());
+        if (!item_pixmap || item_pixmap->version != item_commands->version || item_pixmap->size != size || item_pixmap->device_pixel_ratio != device_pixel_ratio)
+        {
+            item_pixmap = new ItemPixmap();
+            item_pixmap->version = item_commands->version;
+            item_pixmap->size = size;
+            item_pixmap->device_pixel_ratio = device_pixel_ratio;
+            item_pixmap->pixmap = QPixmap(size * device_pixel_ratio);
+            item_pixmap->pixmap.setDevicePixelRatio(device_pixel_ratio);
+            item_pixmap->pixmap.fill(Qt::transparent);
+            {
+                QPainter pixmap_painter(&item_pixmap->pixmap);
+                pixmap_painter.setRenderHints(DEFAULT_RENDER_HINTS | QPainter::SmoothPixmapTransform);
+                PaintBinaryCommands(&pixmap_painter, item_commands->commands, item_commands->image_map, RenderedTimeStamps(), 0.0, 0, device_pixel_ratio);
+            }
+            int cost = qMax(1, static_cast<int>(item_pixmap->pixmap.width() * item_pixmap->pixmap.height() * 4 / 1024));
+            m_item_pixmaps.insert((quint32)index.internalId(), item_pixmap, cost);
+            // the cache deletes pixmaps larger than its capacity immediately.
+            item_pixmap = m_item_pixmaps.object((quint32)index.internalId());
+        }
+        if (item_pixmap)
+            painter->drawPixmap(option.rect.topLeft(), item_pixmap->pixmap);
+    }
+    else if (m_py_object.isValid())
     {
         PyDrawingContext *dc = new PyDrawingContext(painter);
         // NOTE: dc is based on painter which is passed to this method. it is only valid during this method call.
@@ -6,15 +6,23 @@
 #define DOCUMENT_WINDOW_H
 
 #include <QtCore/QAbstractListModel>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QCache>
 #include <QtCore/QDateTime>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
 #include <QtCore/QMutex>
+#include <QtCore/QPointer>
 #include <QtCore/QQueue>
 #include <QtCore/QRunnable>
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
 #include <QtGui/QAction>
 #include <QtGui/QDrag>
+#include <QtGui/QFont>
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+#include <QtGui/QTransform>
 #include <QtGui/QWheelEvent>
 #include <QtWidgets/QAbstractItemView>
 #include <QtWidgets/QButtonGroup>
@@ -47,6 +55,7 @@ class Application;
 class ItemModel;
 class ListModel;
 
+class EventCoalescer;
 class PyCanvas;
 
 class DocumentWindow : public QMainWindow
@@ -63,6 +72,9 @@ public:
     void requestRepaint(PyCanvas *canvas);
     void cancelRepaintRequest(PyCanvas *canvas);
 
+    void queueEventBatch(QWidget *widget, EventCoalescer *event_coalescer);
+    void dispatchEventBatch();
+
 public Q_SLOTS:
     void screenChanged(QScreen *screen);
     void logicalDotsPerInchChanged(qreal dpi);
@@ -96,6 +108,10 @@ private:
 
     QScreen *m_screen;
 
+    // event coalescers with pending events to be dispatched in the next batch. only accessed from the UI thread.
+    QList<QPair<QPointer<QWidget>, EventCoalescer *>> m_event_batch;
+    bool m_event_batch_scheduled;
+
     Application *application() const;
 
     friend class Application;
@@ -237,6 +253,7 @@ public:
     void endRemoveRowsInParent();
     void dataChangedInParent(int row, int parent_row, int parent_item_id);
     QModelIndex indexInParent(int index, int parent_row, int parent_item_id);
+    void setRows(quint32 parent_item_id, const QVariantList &rows);
 
     // from QAbstractListModel
     virtual Qt::DropActions supportedDropActions() const override;
@@ -256,6 +273,21 @@ public:
 private:
     QVariant m_py_object;
     Qt::DropAction m_last_drop_action;
+
+    // item structure and values supplied by setRows, used instead of querying Python. only accessed from the UI thread.
+    struct CachedItem
+    {
+        quint32 parent_item_id;
+        int row;
+        QVariant display_value;
+        QVariant edit_value;
+        bool has_display_value;
+        bool has_edit_value;
+    };
+    mutable QHash<quint32, QVector<quint32>> m_cached_children;
+    mutable QHash<quint32, CachedItem> m_cached_items;
+
+    void removeCachedChildren(quint32 parent_item_id, bool recursive);
 };
 
 struct CanvasDrawingCommand
@@ -291,7 +323,218 @@ typedef QList<RenderedTimeStamp> RenderedTimeStamps;
 
 typedef std::shared_ptr<std::vector<quint32>> CommandsSharedPtr;
 
-RenderedTimeStamps PaintBinaryCommands(QPainter *painter, const CommandsSharedPtr &commands, const QMap<QString, QVariant> &imageMap, const RenderedTimeStamps &lastRenderedTimestamps, float display_scaling = 0.0, int section_id = 0, float devicePixelRatio = 1.0);
+/*
+ The bounds of a primitive drawn with an item tag (itag command).
+ */
+struct TaggedBounds
+{
+    QRectF bounds;
+    quint32 tag;
+
+    TaggedBounds() : tag(0) { }
+    TaggedBounds(const QRectF &bounds, quint32 tag) : bounds(bounds), tag(tag) { }
+};
+
+class DataProbe;
+
+typedef std::shared_ptr<DataProbe> DataProbeSharedPtr;
+typedef QVector<DataProbeSharedPtr> DataProbes;
+
+/*
+ A raster of commands rendered with the linear part of the device transform and a raster mode (render hints, stroke
+ tolerance, downscale mode, and font hinting). The tagged bounds recorded while rendering the raster, and the data
+ probes, are kept with it so that they can be recorded again each time it is drawn.
+ */
+struct CachedRaster
+{
+    QTransform raster_transform;
+    quint64 raster_mode;
+    QRect raster_rect;
+    QImage raster_image;
+    QVector<TaggedBounds> raster_tagged_bounds;  // in raster pixels
+    DataProbes raster_data_probes;  // transforms to raster pixels
+    quint64 last_used;
+
+    CachedRaster() : raster_mode(0), last_used(0) { }
+};
+
+/*
+ A display list is a named command sub-stream registered once per canvas and drawn by reference in later frames.
+
+ The commands are stored in the same binary form as section commands along with the image map needed to draw
+ them. If the bounds are non-empty, the display list may also be drawn from a raster cached at the device scale.
+ */
+class DisplayList
+{
+public:
+    // v2 commands are decoded; commands() is null if they are malformed.
+    DisplayList(const CommandsSharedPtr &commands, const QMap<QString, QVariant> &image_map, const QRectF &bounds);
+
+    const CommandsSharedPtr commands() const { return m_commands; }
+    const QMap<QString, QVariant> &imageMap() const { return m_image_map; }
+    const QRectF &bounds() const { return m_bounds; }
+
+    bool isIdentical(const DisplayList &display_list) const;
+
+    // whether drawing the display list may block, for instance to take the GIL to draw data.
+    bool mayBlock() const { return m_may_block; }
+
+    // the raster cache is shared between render threads, so it is protected by its own mutex. the mutex is never
+    // held while rendering, since the display list may use other display lists. there is a raster per transform and
+    // raster mode, so that the preview and final passes of progressive rendering do not evict each other.
+    QMutex raster_mutex;
+    QVector<CachedRaster> rasters;
+    quint64 raster_use_count;
+private:
+    CommandsSharedPtr m_commands;
+    QMap<QString, QVariant> m_image_map;
+    QRectF m_bounds;
+    bool m_may_block;
+};
+
+typedef std::shared_ptr<DisplayList> DisplayListSharedPtr;
+
+class DisplayListRegistry
+{
+public:
+    DisplayListRegistry() : m_generation(0) { }
+
+    void define(int display_list_id, const DisplayListSharedPtr &display_list);
+    void remove(int display_list_id);
+    DisplayListSharedPtr get(int display_list_id);
+
+    // incremented each time a display list changes.
+    quint64 generation() const { return m_generation.loadAcquire(); }
+private:
+    QMutex m_mutex;
+    QMap<int, DisplayListSharedPtr> m_display_lists;
+    QAtomicInteger<quint64> m_generation;
+};
+
+/*
+ A cached raster of a layer (a group of commands introduced by the lyrb command), valid for a version of the layer.
+ */
+struct LayerCacheEntry : public CachedRaster
+{
+    quint32 version;
+
+    LayerCacheEntry() : version(0) { }
+};
+
+/*
+ The per-canvas cache of layer rasters.
+
+ A layer may have a raster per linear transform and raster mode, so that the preview and final passes of progressive
+ rendering do not evict each other. Inserting a raster for a new version of a layer drops those of older versions.
+ The cache is shared between render threads. The least recently used rasters are evicted when the total size
+ exceeds the limit.
+ */
+class LayerCache
+{
+public:
+    LayerCache() : m_use_count(0), m_byte_count(0), m_hit_count(0), m_miss_count(0) { }
+
+    bool find(quint32 key, quint32 version, const QTransform &raster_transform, quint64 raster_mode, QRect &raster_rect, QImage &raster_image, QVector<TaggedBounds> &raster_tagged_bounds, DataProbes &raster_data_probes);
+    void insert(quint32 key, quint32 version, const QTransform &raster_transform, quint64 raster_mode, const QRect &raster_rect, const QImage &raster_image, const QVector<TaggedBounds> &raster_tagged_bounds, const DataProbes &raster_data_probes);
+    void clear();
+
+    void getStatistics(QVariantMap &statistics);
+private:
+    QMutex m_mutex;
+    QMap<quint32, QVector<LayerCacheEntry>> m_entries;
+    quint64 m_use_count;
+    qint64 m_byte_count;
+    quint64 m_hit_count;
+    quint64 m_miss_count;
+};
+
+/*
+ Counters accumulated by the render threads of a canvas; used for tuning the drawing commands.
+ */
+struct RenderStatistics
+{
+    QAtomicInteger<quint64> drawn_count;
+    QAtomicInteger<quint64> culled_count;
+    QAtomicInteger<quint64> merged_count;
+    QAtomicInteger<quint64> simplified_input_vertex_count;
+    QAtomicInteger<quint64> simplified_output_vertex_count;
+    QAtomicInteger<quint64> rendered_frame_count;
+    QAtomicInteger<quint64> skipped_frame_count;
+    QAtomicInteger<quint64> promoted_frame_count;
+    QAtomicInteger<quint64> preview_frame_count;
+    QAtomicInteger<quint64> cancelled_refinement_count;
+
+    RenderStatistics()
+    : drawn_count(0), culled_count(0), merged_count(0), simplified_input_vertex_count(0), simplified_output_vertex_count(0)
+    , rendered_frame_count(0), skipped_frame_count(0), promoted_frame_count(0), preview_frame_count(0), cancelled_refinement_count(0) { }
+
+    void getStatistics(QVariantMap &statistics) const;
+};
+
+/*
+ A grid index of tagged primitives in canvas coordinates, built when a section is rendered.
+
+ The index is immutable so it can be shared between the render thread that builds it and the UI thread that queries
+ it. Only bounds are indexed, so a point within the bounds of a primitive but outside of its shape still hits it.
+ */
+class HitTestIndex
+{
+public:
+    HitTestIndex(const QVector<TaggedBounds> &entries);
+
+    const QVector<TaggedBounds> &entries() const { return m_entries; }
+
+    QVector<quint32> hitTest(const QPointF &point) const;
+private:
+    QVector<TaggedBounds> m_entries;
+    QHash<quint64, QVector<int>> m_cells;
+    QVector<int> m_large_entries;  // entries covering too many cells are always tested
+};
+
+typedef std::shared_ptr<HitTestIndex> HitTestIndexSharedPtr;
+
+/*
+ The display lists being rasterized by the current thread, innermost first.
+ */
+struct DisplayListRasterStack
+{
+    const DisplayList *display_list;
+    const DisplayListRasterStack *next;
+};
+
+/*
+ Per-canvas state available while painting binary commands. All members are optional.
+ */
+struct PaintBinaryContext
+{
+    DisplayListRegistry *display_lists;
+    LayerCache *layers;
+    RenderStatistics *statistics;
+    QVector<TaggedBounds> *tagged_bounds;  // receives the device bounds of tagged primitives
+    DataProbes *data_probes;  // receives the source arrays of data commands
+    float stroke_tolerance;  // device pixels; zero to disable stroke simplification
+    Qt::TransformationMode downscale_mode;  // filter used to downscale images
+    QFont::HintingPreference font_hinting;
+    bool blocking_allowed;  // false on the UI thread; display lists that may block are skipped
+    const DisplayListRasterStack *raster_stack;  // display lists on the stack are not rasterized again
+    int depth;
+
+    PaintBinaryContext()
+    : display_lists(nullptr), layers(nullptr), statistics(nullptr), tagged_bounds(nullptr), data_probes(nullptr), stroke_tolerance(0.0)
+    , downscale_mode(Qt::SmoothTransformation)
+    , font_hinting(QFont::PreferDefaultHinting), blocking_allowed(true), raster_stack(nullptr), depth(0) { }
+};
+
+RenderedTimeStamps PaintBinaryCommands(QPainter *painter, const CommandsSharedPtr &commands, const QMap<QString, QVariant> &imageMap, const RenderedTimeStamps &lastRenderedTimestamps, float display_scaling = 0.0, int section_id = 0, float devicePixelRatio = 1.0, PaintBinaryContext *context = nullptr);
+
+bool ApplyBinaryCommandsPatches(const std::vector<quint32> &commands, const quint32 *patches, unsigned int patch_word_count, std::vector<quint32> &patched_commands);
+bool IsBinaryCommandsV2(const quint32 *commands, unsigned int command_count);
+bool DecodeBinaryCommandsV2(const quint32 *commands, unsigned int command_count, std::vector<quint32> &decoded_commands);
+CommandsSharedPtr DecodeBinaryCommands(const CommandsSharedPtr &commands);
+bool BinaryCommandsMayBlock(const quint32 *commands, unsigned int command_count);
+bool EncodeBinaryCommandsV2(const quint32 *commands, unsigned int command_count, quint32 flags, std::vector<quint32> &encoded_commands);
+
+QColor ParseColorString(const QString &color_string);
 
 class PyStyledItemDelegate : public QStyledItemDelegate
 {
@@ -301,6 +544,10 @@ public:
 
     void setPyObject(const QVariant &py_object) { m_py_object = py_object; }
 
+    void setItemCommands(quint32 item_id, qint64 version, const CommandsSharedPtr &commands, const QMap<QString, QVariant> &image_map);
+    void clearItemCommands(quint32 item_id);
+    void clearAllItemCommands();
+
     virtual void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
     virtual QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
 
@@ -309,6 +556,27 @@ private Q_SLOTS:
 
 private:
     QVariant m_py_object;
+
+    // binary commands supplied for an item, drawn in item coordinates.
+    struct ItemCommands
+    {
+        qint64 version;
+        CommandsSharedPtr commands;
+        QMap<QString, QVariant> image_map;
+    };
+
+    // the rasterized commands of an item, valid for the version, size, and device pixel ratio.
+    struct ItemPixmap
+    {
+        qint64 version;
+        QSize size;
+        qreal device_pixel_ratio;
+        QPixmap pixmap;
+    };
+
+    QHash<quint32, ItemCommands> m_item_commands;
+    mutable QCache<quint32, ItemPixmap> m_item_pixmaps;
+    mutable QPointer<QAbstractItemView> m_item_view;
 };
 
 class PyPushButton : public QPushButton
@@ -470,6 +738,54 @@ private:
     QVariant m_py_object;
 };
 
+/*
+ Coalesces high rate events of a widget before dispatching them to Python.
+
+ With the coalesced policy, an event replaces the arguments of a pending event with the same method, or adds its
+ deltas to them, and the pending events are dispatched in the order first queued once the event loop is idle. Call
+ flush before dispatching any other event to preserve ordering. Only accessed from the UI thread.
+ */
+class EventCoalescer
+{
+public:
+    enum Policy { Immediate, Coalesced, Batched };
+
+    EventCoalescer(QWidget *widget, const QVariant &py_object);
+
+    Policy policy() const { return m_policy; }
+    void setPolicy(Policy policy);
+
+    void post(const QString &method, const QVariantList &args);
+    void queue(const QString &method, const QVariantList &args);
+    void accumulate(const QString &method, const QVariantList &args, int delta_index, int delta_count);
+    void flush();
+    void takePendingEvents(QVariantList &records);
+
+    void getStatistics(QVariantMap &statistics) const;
+
+private:
+    struct PendingEvent
+    {
+        QString method;
+        QVariantList args;
+    };
+
+    QWidget *m_widget;
+    const QVariant &m_py_object;
+    Policy m_policy;
+    QList<PendingEvent> m_pending_events;
+    bool m_flush_scheduled;
+    quint64 m_queued_count;
+    quint64 m_merged_count;
+    quint64 m_dispatched_count;
+    quint64 m_batched_count;
+
+    PendingEvent *findPendingEvent(const QString &method);
+    void dispatch(const QString &method, const QVariantList &args);
+    void scheduleFlush();
+    DocumentWindow *documentWindow() const;
+};
+
 class PyScrollArea : public QScrollArea
 {
     Q_OBJECT
@@ -478,6 +794,8 @@ public:
 
     void setPyObject(const QVariant &py_object) { m_py_object = py_object; }
 
+    EventCoalescer &eventCoalescer() { return m_event_coalescer; }
+
     virtual void resizeEvent(QResizeEvent *event) override;
     virtual bool eventFilter(QObject *obj, QEvent *event) override;
 
@@ -489,6 +807,7 @@ public Q_SLOTS:
 
 private:
     QVariant m_py_object;
+    EventCoalescer m_event_coalescer;
 
     void notifyViewportChanged();
 };
@@ -522,31 +841,81 @@ private:
 class PyCanvas;
 class PyCanvasRenderTask;
 
+/*
+ The drawing commands for a canvas section.
+
+ The dirty rect (in canvas coordinates) is the area that changed since the previous drawing commands submitted to
+ the section. If it is empty, the entire section is considered changed.
+ */
 class DrawingCommands
 {
 public:
-    DrawingCommands(const CommandsSharedPtr &commands, const QRect &rect, const QMap<QString, QVariant> &image_map)
-    : m_commands(commands), m_rect(rect), m_image_map(image_map) { }
+    DrawingCommands(const CommandsSharedPtr &commands, const QRect &rect, const QMap<QString, QVariant> &image_map, const QRect &dirty_rect = QRect());
+    DrawingCommands(const DrawingCommands &drawing_commands, const QRect &dirty_rect);
 
+    // the commands as submitted, which may be v2; patches apply to these.
     const CommandsSharedPtr commands() const { return m_commands; }
+    // the commands in v1 form, decoded once on submission; null if the submitted commands are malformed.
+    const CommandsSharedPtr paintCommands() const { return m_paint_commands; }
+    bool isValid() const { return m_paint_commands != nullptr; }
     const QMap<QString, QVariant> &imageMap() const { return m_image_map; }
     const QRect &rect() const { return m_rect; }
+    const QRect &dirtyRect() const { return m_dirty_rect; }
+
+    bool isIdentical(const DrawingCommands &drawing_commands) const;
 private:
     CommandsSharedPtr m_commands;
+    CommandsSharedPtr m_paint_commands;
     QMap<QString, QVariant> m_image_map;
     QRect m_rect;
+    QRect m_dirty_rect;
 };
 
 typedef std::shared_ptr<DrawingCommands> DrawingCommandsSharedPtr;
 
+/*
+ Options to render a canvas section. A render task copies the options of its section when it is created.
+
+ The render mode trades quality for speed. Interactive disables antialiasing, smooth image downscaling, and font
+ hinting. Balanced is the default. Quality also enables smooth pixmap transforms. If promote_ms is not zero, a
+ section not rendered in quality mode is rendered again in quality mode once no commands have been submitted to it
+ for promote_ms milliseconds.
+
+ A progressive render first presents a preview rendered in interactive mode, at preview_scale times the device pixel
+ ratio, and then refines it unless newer commands were submitted in the meantime.
+ */
+struct CanvasRenderOptions
+{
+    enum RenderMode { Interactive, Balanced, Quality };
+
+    RenderMode render_mode;
+    int promote_ms;
+    bool progressive;
+    float preview_scale;
+    float stroke_tolerance;
+
+    CanvasRenderOptions() : render_mode(Balanced), promote_ms(0), progressive(false), preview_scale(1.0), stroke_tolerance(0.0) { }
+};
+
 class CanvasSection
 {
 public:
     int m_section_id;
+    CanvasRenderOptions m_render_options;
+    quint64 m_generation;  // incremented each time new drawing commands are submitted
+    bool m_promoted;  // whether the last drawing commands are rendered in quality mode by promotion
+    QTransform m_transform;  // applied to the image until the transform is reset
+    quint64 m_transform_reset_generation;  // the transform is reset once commands of this generation or newer are rendered
+    QColor m_placeholder_color;
+    HitTestIndexSharedPtr m_hit_test_index;
+    DataProbes m_data_probes;
     DrawingCommandsSharedPtr m_pending_drawing_commands;
+    DrawingCommandsSharedPtr m_last_drawing_commands;
+    quint64 m_last_display_list_generation;  // the display list generation when the last drawing commands were submitted
     float m_device_pixel_ratio;
     QRect image_rect;
     QSharedPointer<QImage> image;
+    bool image_is_preview;
     RenderedTimeStamps m_rendered_timestamps;
     PyCanvasRenderTask *m_render_task;
     QQueue<int64_t> latencies_ns;
@@ -555,6 +924,8 @@ public:
     bool closing;
 
     CanvasSection(int section_id, float device_pixel_ratio);
+
+    CanvasRenderOptions renderOptions() const;
 };
 
 typedef std::shared_ptr<CanvasSection> CanvasSectionSharedPtr;
@@ -574,9 +945,13 @@ struct RenderResult
     RenderedTimeStamps rendered_timestamps;
     QSharedPointer<QImage> image;
     QRect image_rect;
+    HitTestIndexSharedPtr hit_test_index;
+    DataProbes data_probes;
     bool record_latency;
+    bool is_preview;  // the image is a progressive preview and must not be the base of a partial render
+    quint64 generation;
 
-    RenderResult(const CanvasSectionSharedPtr &section) : section(section), record_latency(false) { }
+    RenderResult(const CanvasSectionSharedPtr &section, quint64 generation) : section(section), record_latency(false), is_preview(false), generation(generation) { }
 };
 
 /*
@@ -588,18 +963,26 @@ struct RenderResult
 class PyCanvasRenderTask : public QRunnable
 {
 public:
-    PyCanvasRenderTask(PyCanvas *canvas, const CanvasSectionSharedPtr &section, const DrawingCommandsSharedPtr &drawing_commands, float devicePixelRatio, const RenderedTimeStamps &rendered_timestamps);
+    PyCanvasRenderTask(PyCanvas *canvas, const CanvasSectionSharedPtr &section, const DrawingCommandsSharedPtr &drawing_commands, float devicePixelRatio, const RenderedTimeStamps &rendered_timestamps, const QSharedPointer<QImage> &base_image, const QRect &base_image_rect);
 
     virtual void run() override;
 
     const CanvasSectionSharedPtr section() const { return m_section; }
 
 private:
+    void paint(RenderResult &render_result, const CanvasRenderOptions &render_options, float device_pixel_ratio, bool is_partial);
+
     PyCanvas *m_canvas;
     const CanvasSectionSharedPtr m_section;
     const DrawingCommandsSharedPtr m_drawing_commands;
     float m_device_pixel_ratio;
     const RenderedTimeStamps m_rendered_timestamps;
+    const QSharedPointer<QImage> m_base_image;
+    const QRect m_base_image_rect;
+    const CanvasRenderOptions m_render_options;
+    const quint64 m_generation;
+    const HitTestIndexSharedPtr m_base_hit_test_index;
+    const DataProbes m_base_data_probes;
 };
 
 class PyCanvas : public QWidget
@@ -638,19 +1021,57 @@ public:
     virtual void dropEvent(QDropEvent *event) override;
 
     void setCommands(const QList<CanvasDrawingCommand> &commands);
-    void setBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands);
+    void setBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands, bool force = false);
+    bool patchBinarySectionCommands(int section_id, const quint32 *patches, unsigned int patch_word_count, const QRect &rect, const QMap<QString, QVariant> &image_map, const QRect &dirty_rect);
     void removeSection(int section_id);
+    void setSectionStrokeSimplification(int section_id, float tolerance);
+    void setSectionRenderMode(int section_id, CanvasRenderOptions::RenderMode render_mode, int promote_ms);
+    void setSectionProgressive(int section_id, bool progressive, float preview_scale);
+    void setSectionTransform(int section_id, const QTransform &transform, const QColor &placeholder_color);
+    void setOverlayCommands(const DrawingCommandsSharedPtr &drawing_commands);
+    void setCrosshair(bool enabled, const QColor &color);
+
+    QVector<quint32> hitTest(const QPointF &point);
+    bool probeData(const QPointF &point, QVariantMap &result);
+    void setDataReadout(bool enabled);
+
+    DisplayListRegistry &displayLists() { return m_display_lists; }
+    LayerCache &layers() { return m_layers; }
+    RenderStatistics &statistics() { return m_render_statistics; }
+    EventCoalescer &eventCoalescer() { return m_event_coalescer; }
+
+    QVariantMap renderStatistics();
 
     void grabMouse0(const QPoint &gp);
     void releaseMouse0();
 
     void continuePaintingSection(const RenderResult &render_result);
+    bool presentSectionPreview(const RenderResult &render_result);
 
 private:
+    CanvasSectionSharedPtr ensureSection(int section_id);
+    bool submitBinarySectionCommands(int section_id, const DrawingCommandsSharedPtr &drawing_commands, bool force, const CommandsSharedPtr *base_commands);
+    void promoteSection(int section_id, quint64 generation);
+    void updateCrosshair(const QPoint &pos, bool visible);
+    void updateDataReadout(const QPoint &pos, bool visible);
+
     bool m_closing;
     QVariant m_py_object;
+    EventCoalescer m_event_coalescer;
     QMutex m_sections_mutex;
     QMap<int, CanvasSectionSharedPtr> m_sections;
+    DisplayListRegistry m_display_lists;
+    LayerCache m_layers;
+    RenderStatistics m_render_statistics;
+    DrawingCommandsSharedPtr m_overlay_commands;
+    LayerCache m_overlay_layers;  // separate from the section layers so that layer keys do not collide
+    bool m_crosshair_enabled;  // crosshair state is only accessed from the UI thread
+    bool m_crosshair_visible;
+    QColor m_crosshair_color;
+    QPoint m_crosshair_pos;
+    bool m_data_readout_enabled;  // data readout state is only accessed from the UI thread
+    QString m_data_readout_text;
+    QRect m_data_readout_rect;
     QPoint m_last_pos;
     bool m_pressed;
     unsigned m_grab_mouse_count;
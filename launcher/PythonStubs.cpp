@@ -34,6 +34,7 @@ typedef int (*PyCapsule_IsValidFn)(PyObject *capsule, const char *name);
 typedef PyObject* (*PyCapsule_NewFn)(void *pointer, const char *name, PyCapsule_Destructor destructor);
 typedef PyObject* (*PyDict_GetItemStringFn)(PyObject *p, const char *key);
 typedef PyObject* (*PyDict_NewFn)();
+typedef int (*PyDict_NextFn)(PyObject *p, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue);
 typedef int (*PyDict_SetItemFn)(PyObject *p, PyObject *key, PyObject *val);
 typedef void (*PyErr_ClearFn)();
 typedef PyObject* (*PyErr_FormatFn)(PyObject *exception, const char *format, ...);
@@ -76,6 +77,7 @@ typedef int (*PyObject_GetBufferFn)(PyObject *o, Py_buffer *view, int flags);
 typedef int (*PyObject_HasAttrStringFn)(PyObject *o, const char *attr_name);
 typedef int (*PyObject_IsTrueFn)(PyObject *o);
 typedef int (*PyObject_SetAttrFn)(PyObject *o, PyObject *attr_name, PyObject *v);
+typedef PyObject* (*PyObject_VectorcallMethodFn)(PyObject *name, PyObject *const *args, size_t nargsf, PyObject *kwnames);
 typedef PyObject* (*PyRun_SimpleStringFn)(const char *str);
 typedef PyObject* (*PyRun_StringFlagsFn)(const char *str, int start, PyObject *globals, PyObject *locals, PyCompilerFlags *flags);
 typedef int (*PySequence_CheckFn)(PyObject *o);
@@ -88,8 +90,11 @@ typedef PyObject* (*PyTuple_NewFn)(Py_ssize_t len);
 typedef int (*PyTuple_SetItemFn)(PyObject *p, Py_ssize_t pos, PyObject *o);
 typedef int (*PyType_IsSubtypeFn)(PyTypeObject *a, PyTypeObject *b);
 typedef char* (*PyUnicode_AsUTF8Fn)(PyObject *unicode);
+typedef const char* (*PyUnicode_AsUTF8AndSizeFn)(PyObject *unicode, Py_ssize_t *size);
 typedef PyObject* (*PyUnicode_DecodeUTF16Fn)(const char *s, Py_ssize_t size, const char *errors, int *byteorder);
 typedef PyObject *(*PyUnicode_FromStringFn)(const char *u);
+typedef PyObject *(*PyUnicode_FromStringAndSizeFn)(const char *u, Py_ssize_t size);
+typedef PyObject *(*PyUnicode_InternFromStringFn)(const char *u);
 typedef wchar_t *(*PyUnicode_AsWideCharStringFn)(PyObject *unicode, Py_ssize_t *size);
 typedef void (*PyMem_FreeFn)(void *p);
 typedef PyObject* (*Py_CompileStringExFlagsFn)(const char *str, const char *filename, int start, PyCompilerFlags *flags, int optimize);
@@ -106,6 +111,7 @@ static PyCapsule_IsValidFn fCapsule_IsValid = 0;
 static PyCapsule_NewFn fCapsule_New = 0;
 static PyDict_GetItemStringFn fDict_GetItemString = 0;
 static PyDict_NewFn fDict_New = 0;
+static PyDict_NextFn fDict_Next = 0;
 static PyDict_SetItemFn fDict_SetItem = 0;
 static PyErr_ClearFn fErr_Clear = 0;
 static PyErr_FormatFn fErr_Format = 0;
@@ -148,6 +154,7 @@ static PyObject_GetBufferFn fObject_GetBuffer = 0;
 static PyObject_HasAttrStringFn fObject_HasAttrString = 0;
 static PyObject_IsTrueFn fObject_IsTrue = 0;
 static PyObject_SetAttrFn fObject_SetAttr = 0;
+static PyObject_VectorcallMethodFn fObject_VectorcallMethod = 0;
 static PyRun_SimpleStringFn fRun_SimpleString = 0;
 static PyRun_StringFlagsFn fRun_StringFlags = 0;
 static PySequence_CheckFn fSequence_Check = 0;
@@ -160,8 +167,11 @@ static PyTuple_NewFn fTuple_New = 0;
 static PyTuple_SetItemFn fTuple_SetItem = 0;
 static PyType_IsSubtypeFn fType_IsSubtype = 0;
 static PyUnicode_AsUTF8Fn fUnicode_AsUTF8 = 0;
+static PyUnicode_AsUTF8AndSizeFn fUnicode_AsUTF8AndSize = 0;
 static PyUnicode_DecodeUTF16Fn fUnicode_DecodeUTF16 = 0;
 static PyUnicode_FromStringFn fUnicode_FromString = 0;
+static PyUnicode_FromStringAndSizeFn fUnicode_FromStringAndSize = 0;
+static PyUnicode_InternFromStringFn fUnicode_InternFromString = 0;
 static PyUnicode_AsWideCharStringFn fUnicode_AsWideCharString = 0;
 static PyMem_FreeFn fMem_Free = 0;
 static Py_CompileStringExFlagsFn fCompileStringExFlags = 0;
@@ -187,6 +197,7 @@ void deinitialize_pylib()
     fCapsule_New = 0;
     fDict_GetItemString = 0;
     fDict_New = 0;
+    fDict_Next = 0;
     fDict_SetItem = 0;
     fErr_Clear = 0;
     fErr_Format = 0;
@@ -229,6 +240,7 @@ void deinitialize_pylib()
     fObject_HasAttrString = 0;
     fObject_IsTrue = 0;
     fObject_SetAttr = 0;
+    fObject_VectorcallMethod = 0;
     fRun_SimpleString = 0;
     fRun_StringFlags = 0;
     fSequence_Check = 0;
@@ -241,8 +253,11 @@ void deinitialize_pylib()
     fTuple_SetItem = 0;
     fType_IsSubtype = 0;
     fUnicode_AsUTF8 = 0;
+    fUnicode_AsUTF8AndSize = 0;
     fUnicode_DecodeUTF16 = 0;
     fUnicode_FromString = 0;
+    fUnicode_FromStringAndSize = 0;
+    fUnicode_InternFromString = 0;
     fCompileStringExFlags = 0;
     fInitialize = 0;
     fFinalize = 0;
@@ -357,6 +372,13 @@ PyObject* DPyDict_New()
     return fDict_New();
 }
 
+int DPyDict_Next(PyObject *p, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue)
+{
+    if (fDict_Next == 0)
+        fDict_Next = (PyDict_NextFn)LOOKUP_SYMBOL(pylib, "PyDict_Next");
+    return fDict_Next(p, ppos, pkey, pvalue);
+}
+
 int DPyDict_SetItem(PyObject *p, PyObject *key, PyObject *val)
 {
     if (fDict_SetItem == 0)
@@ -651,6 +673,13 @@ int DPyObject_SetAttr(PyObject *o, PyObject *attr_name, PyObject *v)
     return fObject_SetAttr(o, attr_name, v);
 }
 
+PyObject* DPyObject_VectorcallMethod(PyObject *name, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (fObject_VectorcallMethod == 0)
+        fObject_VectorcallMethod = (PyObject_VectorcallMethodFn)LOOKUP_SYMBOL(pylib, "PyObject_VectorcallMethod");
+    return fObject_VectorcallMethod(name, args, nargsf, kwnames);
+}
+
 PyObject* DPyRun_SimpleString(const char *str)
 {
     if (fRun_SimpleString == 0)
@@ -735,6 +764,13 @@ char* DPyUnicode_AsUTF8(PyObject *unicode)
     return fUnicode_AsUTF8(unicode);
 }
 
+const char* DPyUnicode_AsUTF8AndSize(PyObject *unicode, Py_ssize_t *size)
+{
+    if (fUnicode_AsUTF8AndSize == 0)
+        fUnicode_AsUTF8AndSize = (PyUnicode_AsUTF8AndSizeFn)LOOKUP_SYMBOL(pylib, "PyUnicode_AsUTF8AndSize");
+    return fUnicode_AsUTF8AndSize(unicode, size);
+}
+
 PyObject* DPyUnicode_DecodeUTF16(const char *s, Py_ssize_t size, const char *errors, int *byteorder)
 {
     if (fUnicode_DecodeUTF16 == 0)
@@ -749,6 +785,20 @@ PyObject* DPyUnicode_FromString(const char *u)
     return fUnicode_FromString(u);
 }
 
+PyObject* DPyUnicode_FromStringAndSize(const char *u, Py_ssize_t size)
+{
+    if (fUnicode_FromStringAndSize == 0)
+        fUnicode_FromStringAndSize = (PyUnicode_FromStringAndSizeFn)LOOKUP_SYMBOL(pylib, "PyUnicode_FromStringAndSize");
+    return fUnicode_FromStringAndSize(u, size);
+}
+
+PyObject* DPyUnicode_InternFromString(const char *u)
+{
+    if (fUnicode_InternFromString == 0)
+        fUnicode_InternFromString = (PyUnicode_InternFromStringFn)LOOKUP_SYMBOL(pylib, "PyUnicode_InternFromString");
+    return fUnicode_InternFromString(u);
+}
+
 wchar_t *DPyUnicode_AsWideCharString(PyObject *unicode, Py_ssize_t *size)
 {
     if (fUnicode_AsWideCharString == 0)
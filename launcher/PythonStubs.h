@@ -10,6 +10,7 @@ int DECLARE_PY(PyCapsule_IsValid)(PyObject *capsule, const char *name);
 PyObject* DECLARE_PY(PyCapsule_New)(void *pointer, const char *name, PyCapsule_Destructor destructor);
 PyObject* DECLARE_PY(PyDict_GetItemString)(PyObject *p, const char *key);
 PyObject* DECLARE_PY(PyDict_New)();
+int DECLARE_PY(PyDict_Next)(PyObject *p, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue);
 int DECLARE_PY(PyDict_SetItem)(PyObject *p, PyObject *key, PyObject *val);
 void DECLARE_PY(PyErr_Clear)();
 PyObject* DECLARE_PY(PyErr_Format)(PyObject *exception, const char *format, ...);
@@ -53,6 +54,7 @@ int DECLARE_PY(PyObject_GetBuffer)(PyObject *exporter, Py_buffer *view, int flag
 int DECLARE_PY(PyObject_HasAttrString)(PyObject *o, const char *attr_name);
 int DECLARE_PY(PyObject_IsTrue)(PyObject *o);
 int DECLARE_PY(PyObject_SetAttr)(PyObject *o, PyObject *attr_name, PyObject *v);
+PyObject* DECLARE_PY(PyObject_VectorcallMethod)(PyObject *name, PyObject *const *args, size_t nargsf, PyObject *kwnames);
 PyObject* DECLARE_PY(PyRun_SimpleString)(const char *str);
 PyObject* DECLARE_PY(PyRun_StringFlags)(const char *str, int start, PyObject *globals, PyObject *locals, PyCompilerFlags *flags);
 int DECLARE_PY(PySequence_Check)(PyObject *o);
@@ -65,8 +67,11 @@ PyObject* DECLARE_PY(PyTuple_New)(Py_ssize_t len);
 int DECLARE_PY(PyTuple_SetItem)(PyObject *p, Py_ssize_t pos, PyObject *o);
 int DECLARE_PY(PyType_IsSubtype)(PyTypeObject *a, PyTypeObject *b);
 char* DECLARE_PY(PyUnicode_AsUTF8)(PyObject *unicode);
+const char* DECLARE_PY(PyUnicode_AsUTF8AndSize)(PyObject *unicode, Py_ssize_t *size);
 PyObject* DECLARE_PY(PyUnicode_DecodeUTF16)(const char *s, Py_ssize_t size, const char *errors, int *byteorder);
 PyObject* DECLARE_PY(PyUnicode_FromString)(const char *u);
+PyObject* DECLARE_PY(PyUnicode_FromStringAndSize)(const char *u, Py_ssize_t size);
+PyObject* DECLARE_PY(PyUnicode_InternFromString)(const char *u);
 wchar_t *DECLARE_PY(PyUnicode_AsWideCharString)(PyObject *unicode, Py_ssize_t *size);
 void DECLARE_PY(PyMem_Free)(void *p);
 PyObject* DECLARE_PY(Py_CompileStringExFlags)(const char *str, const char *filename, int start, PyCompilerFlags *flags, int optimize);
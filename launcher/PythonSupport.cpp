@@ -3,7 +3,11 @@
 */
 
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 #if defined(_WIN32) || defined(_WIN64)
 #define OS_WINDOWS 1
@@ -426,15 +430,179 @@ PythonSupport::~PythonSupport()
     Py_XDECREF(module_exception);
 }
 
+struct GILAtomicHistogram
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[GIL_HISTOGRAM_BUCKET_COUNT] = {};
+
+    void record(uint64_t ns)
+    {
+        int bucket = 0;
+        for (uint64_t us = ns / 1000; us > 0 && bucket < GIL_HISTOGRAM_BUCKET_COUNT - 1; us >>= 1)
+            bucket += 1;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t old_max_ns = max_ns.load(std::memory_order_relaxed);
+        while (ns > old_max_ns && !max_ns.compare_exchange_weak(old_max_ns, ns, std::memory_order_relaxed))
+            ;
+    }
+
+    void get(GILDurationHistogram &histogram, bool reset)
+    {
+        histogram.count = reset ? count.exchange(0) : count.load();
+        histogram.total_ns = reset ? total_ns.exchange(0) : total_ns.load();
+        histogram.max_ns = reset ? max_ns.exchange(0) : max_ns.load();
+        histogram.buckets.resize(GIL_HISTOGRAM_BUCKET_COUNT);
+        for (int i = 0; i < GIL_HISTOGRAM_BUCKET_COUNT; ++i)
+            histogram.buckets[i] = reset ? buckets[i].exchange(0) : buckets[i].load();
+    }
+};
+
+struct GILCallSite
+{
+    GILAtomicHistogram wait;
+    GILAtomicHistogram hold;
+};
+
+static std::atomic<bool> gil_instrumentation_enabled(false);
+
+// call sites are never removed so that guards can record into them without holding the mutex.
+static std::mutex gil_call_sites_mutex;
+static std::map<std::string, std::unique_ptr<GILCallSite>> gil_call_sites;
+
+// the time the current thread last acquired the GIL through a guard, or zero if unknown.
+static thread_local std::chrono::steady_clock::time_point gil_acquired_time;
+
+// the call sites found by the current thread, by tag address; tags are string literals, so their addresses are stable.
+static thread_local std::unordered_map<const char *, GILCallSite *> gil_thread_call_sites;
+
+static GILCallSite *FindGILCallSite(const char *tag)
+{
+    if (!gil_instrumentation_enabled.load(std::memory_order_relaxed))
+        return nullptr;
+
+    // only the first use of a tag on each thread takes the mutex.
+    GILCallSite *&thread_call_site = gil_thread_call_sites[tag];
+    if (!thread_call_site)
+    {
+        std::lock_guard<std::mutex> lock(gil_call_sites_mutex);
+        std::unique_ptr<GILCallSite> &call_site = gil_call_sites[tag];
+        if (!call_site)
+            call_site.reset(new GILCallSite());
+        thread_call_site = call_site.get();
+    }
+    return thread_call_site;
+}
+
+static uint64_t ElapsedNanoseconds(const std::chrono::steady_clock::time_point &start, const std::chrono::steady_clock::time_point &end)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+void SetGILInstrumentationEnabled(bool enabled)
+{
+    gil_instrumentation_enabled.store(enabled);
+}
+
+bool IsGILInstrumentationEnabled()
+{
+    return gil_instrumentation_enabled.load();
+}
+
+void GetGILStatistics(std::map<std::string, GILCallSiteStatistics> &statistics, bool reset)
+{
+    std::lock_guard<std::mutex> lock(gil_call_sites_mutex);
+    for (auto &entry : gil_call_sites)
+    {
+        GILCallSiteStatistics &call_site_statistics = statistics[entry.first];
+        entry.second->wait.get(call_site_statistics.wait, reset);
+        entry.second->hold.get(call_site_statistics.hold, reset);
+    }
+}
+
+/*
+ References and buffers released by threads not holding the GIL are pushed onto a lock-free stack so that render
+ threads do not block on Python to drop them, for instance when destroying drawing commands with an image map. The
+ stack is drained under a single GIL acquisition by the next guard to acquire the GIL on any thread, which includes
+ the periodic dispatch of each document window.
+ */
+struct DeferredPyObject
+{
+    PyObject *py_object;
+    Py_buffer *py_buffer;
+    DeferredPyObject *next;
+};
+
+static std::atomic<DeferredPyObject *> deferred_py_objects(nullptr);
+
+static void DeferRelease(PyObject *py_object, Py_buffer *py_buffer)
+{
+    DeferredPyObject *deferred_py_object = new DeferredPyObject{py_object, py_buffer, deferred_py_objects.load(std::memory_order_relaxed)};
+    while (!deferred_py_objects.compare_exchange_weak(deferred_py_object->next, deferred_py_object, std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+void ReleasePyObject(PyObject *py_object)
+{
+    if (CALL_PY(PyGILState_Check)())
+        Py_DECREF(py_object);
+    else
+        DeferRelease(py_object, nullptr);
+}
+
+void ReleasePyBuffer(const Py_buffer &py_buffer)
+{
+    if (CALL_PY(PyGILState_Check)())
+    {
+        Py_buffer buffer = py_buffer;
+        CALL_PY(PyBuffer_Release)(&buffer);
+    }
+    else
+    {
+        DeferRelease(nullptr, new Py_buffer(py_buffer));
+    }
+}
+
+void ReleaseDeferredPyObjects()
+{
+    // take the whole stack; releasing may run finalizers which defer more references or drain again.
+    DeferredPyObject *deferred_py_object = deferred_py_objects.exchange(nullptr, std::memory_order_acquire);
+    while (deferred_py_object)
+    {
+        DeferredPyObject *next = deferred_py_object->next;
+        if (deferred_py_object->py_buffer)
+        {
+            CALL_PY(PyBuffer_Release)(deferred_py_object->py_buffer);
+            delete deferred_py_object->py_buffer;
+        }
+        else
+        {
+            Py_DECREF(deferred_py_object->py_object);
+        }
+        delete deferred_py_object;
+        deferred_py_object = next;
+    }
+}
+
 struct Python_ThreadBlockState
 {
     PyGILState_STATE gstate;
+    GILCallSite *call_site;
+    std::chrono::steady_clock::time_point acquired_time;
 };
 
 void Python_ThreadBlock::release()
 {
     if (m_state)
     {
+        if (m_state->call_site)
+            m_state->call_site->hold.record(ElapsedNanoseconds(m_state->acquired_time, std::chrono::steady_clock::now()));
+        // the thread no longer holds the GIL unless it held it before the block.
+        if (m_state->gstate == PyGILState_UNLOCKED)
+            gil_acquired_time = std::chrono::steady_clock::time_point();
         CALL_PY(PyGILState_Release)(m_state->gstate);
         delete m_state;
         m_state = NULL;
@@ -444,27 +612,61 @@ void Python_ThreadBlock::release()
 void Python_ThreadBlock::grab()
 {
     m_state = new Python_ThreadBlockState();
-    m_state->gstate = CALL_PY(PyGILState_Ensure)();
+    m_state->call_site = FindGILCallSite(m_tag);
+    if (m_state->call_site)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        m_state->gstate = CALL_PY(PyGILState_Ensure)();
+        m_state->acquired_time = std::chrono::steady_clock::now();
+        m_state->call_site->wait.record(ElapsedNanoseconds(start_time, m_state->acquired_time));
+        if (m_state->gstate == PyGILState_UNLOCKED)
+            gil_acquired_time = m_state->acquired_time;
+    }
+    else
+    {
+        m_state->gstate = CALL_PY(PyGILState_Ensure)();
+    }
+
+    if (deferred_py_objects.load(std::memory_order_relaxed))
+        ReleaseDeferredPyObjects();
 }
 
 struct Python_ThreadAllowState
 {
     PyThreadState *gstate;
+    GILCallSite *call_site;
 };
 
 void Python_ThreadAllow::release()
 {
     if (m_state)
     {
-        CALL_PY(PyEval_RestoreThread)(m_state->gstate);
+        if (m_state->call_site)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            CALL_PY(PyEval_RestoreThread)(m_state->gstate);
+            gil_acquired_time = std::chrono::steady_clock::now();
+            m_state->call_site->wait.record(ElapsedNanoseconds(start_time, gil_acquired_time));
+        }
+        else
+        {
+            CALL_PY(PyEval_RestoreThread)(m_state->gstate);
+        }
         delete m_state;
         m_state = NULL;
+
+        if (deferred_py_objects.load(std::memory_order_relaxed))
+            ReleaseDeferredPyObjects();
     }
 }
 
 void Python_ThreadAllow::grab()
 {
     m_state = new Python_ThreadAllowState();
+    m_state->call_site = FindGILCallSite(m_tag);
+    if (m_state->call_site && gil_acquired_time != std::chrono::steady_clock::time_point())
+        m_state->call_site->hold.record(ElapsedNanoseconds(gil_acquired_time, std::chrono::steady_clock::now()));
+    gil_acquired_time = std::chrono::steady_clock::time_point();
     m_state->gstate = CALL_PY(PyEval_SaveThread)();
 }
 
@@ -532,6 +734,10 @@ void PythonSupport::deinitialize()
     // grab the GIL that was released after Py_Initialize.
     CALL_PY(PyEval_RestoreThread)(m_initial_state);
 
+    clearMethodNames();
+
+    ReleaseDeferredPyObjects();
+
     // finalize.
     CALL_PY(Py_Finalize)();
 }
@@ -703,7 +909,7 @@ void PythonSupport::addResourcePath(const std::string &resources_path)
 
 PythonValueVariant PythonSupport::invokePyMethod(PyObjectPtr *object, const std::string &method, const std::list<PythonValueVariant> &args)
 {
-    Python_ThreadBlock thread_block;
+    Python_ThreadBlock thread_block("invoke py method");
 
     PyObject *py_object = object->get();
 
@@ -755,10 +961,214 @@ PythonValueVariant PythonSupport::invokePyMethod(PyObjectPtr *object, const std:
     return PythonValueVariant();
 }
 
+// call the method with the tuple of arguments (which may be NULL). returns a new reference or NULL on error.
+PyObject *PythonSupport::callPyMethod(PyObjectPtr *object, const std::string &method, PyObject *py_args)
+{
+    Python_ThreadBlock thread_block("call py method");
+
+    PyObject *py_object = object->get();
+
+    if (py_object)
+    {
+        PyObjectPtr callable(CALL_PY(PyObject_GetAttrString)(py_object, method.c_str()));
+        if (CALL_PY(PyCallable_Check)(callable))
+        {
+            CALL_PY(PyErr_Clear)();
+            PyObject *py_result = CALL_PY(PyObject_CallObject)(callable, py_args);
+            if (py_result)
+                return py_result;
+            CALL_PY(PyErr_Print)();
+            CALL_PY(PyErr_Clear)();
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ Call the method on the object, stealing the references to the arguments.
+
+ The first item of py_args is reserved for the object and must be NULL; the remaining items are the arguments. This
+ is equivalent to getattr(py_object, method)(*args) but avoids creating a bound method when the method is a plain
+ function on the type, and looks the method up by an interned name, which Python compares by identity in the type
+ lookup cache. Returns a new reference or NULL on error. The GIL must be held.
+ */
+PyObject *PythonSupport::dispatchPyMethod(PyObject *py_object, const std::string &method, std::vector<PyObject *> &py_args)
+{
+    PyObject *py_result = NULL;
+
+    size_t arg_count = py_args.size() - 1;
+
+    if (std::find(py_args.begin() + 1, py_args.end(), nullptr) == py_args.end())
+    {
+        PyObject *py_name = methodName(method);
+        if (py_name)
+        {
+            py_args[0] = py_object;
+            py_result = CALL_PY(PyObject_VectorcallMethod)(py_name, py_args.data(), arg_count + 1, NULL);
+            py_args[0] = NULL;
+        }
+
+        if (!py_result)
+        {
+            CALL_PY(PyErr_Print)();
+            CALL_PY(PyErr_Clear)();
+        }
+    }
+
+    for (auto py_arg : py_args)
+        Py_XDECREF(py_arg);
+
+    py_args.clear();
+
+    return py_result;
+}
+
+// return a borrowed reference to the interned name of the method, creating it on first use. the GIL must be held.
+PyObject *PythonSupport::methodName(const std::string &method)
+{
+    auto iter = m_method_names.find(method);
+
+    if (iter == m_method_names.end())
+    {
+        PyObject *py_name = CALL_PY(PyUnicode_InternFromString)(method.c_str());
+        if (!py_name)
+            return NULL;
+        iter = m_method_names.insert(std::make_pair(method, py_name)).first;
+    }
+
+    return iter->second;
+}
+
+void PythonSupport::clearMethodNames()
+{
+    for (auto &entry : m_method_names)
+        Py_DECREF(entry.second);
+
+    m_method_names.clear();
+}
+
+// classify the object in the same order as PyObjectToValueVariant.
+PythonSupport::ValueKind PythonSupport::valueKind(PyObject *py_object)
+{
+    if (PyString_Check(py_object) || PyUnicode_Check(py_object))
+        return ValueString;
+    else if (PyInt_Check(py_object))
+        return ValueInt;
+    else if (CALL_PY(PyFloat_Check)(py_object))
+        return ValueFloat;
+    else if (CALL_PY(PyCapsule_IsValid)(py_object, PythonSupport::qobject_capsule_name) && CALL_PY(PyCapsule_CheckExact)(py_object))
+        return ValueCapsule;
+    else if (PyDict_Check(py_object))
+        return ValueDict;
+    else if (PyList_Check(py_object) || PyTuple_Check(py_object))
+        return ValueSequence;
+    else if (py_object == CALL_PY(Py_NoneGet)())
+        return ValueNone;
+    return ValueOther;
+}
+
+// return the UTF-8 contents of a string, owned by the string, or NULL if it is not a string.
+const char *PythonSupport::stringValue(PyObject *py_object, Py_ssize_t &size)
+{
+    const char *s = CALL_PY(PyUnicode_AsUTF8AndSize)(py_object, &size);
+    if (!s)
+        CALL_PY(PyErr_Clear)();
+    return s;
+}
+
+long PythonSupport::intValue(PyObject *py_object)
+{
+    return PyInt_AsLong(py_object);
+}
+
+double PythonSupport::floatValue(PyObject *py_object)
+{
+    return CALL_PY(PyFloat_AsDouble)(py_object);
+}
+
+void *PythonSupport::capsuleValue(PyObject *py_object)
+{
+    return CALL_PY(PyCapsule_GetPointer)(py_object, PythonSupport::qobject_capsule_name);
+}
+
+// iterate the items of a dict; the key and value are borrowed.
+bool PythonSupport::dictNext(PyObject *py_dict, Py_ssize_t &pos, PyObject *&py_key, PyObject *&py_value)
+{
+    return CALL_PY(PyDict_Next)(py_dict, &pos, &py_key, &py_value) != 0;
+}
+
+// return the items of a list or tuple; the items are borrowed and only valid while the sequence is unchanged.
+PyObject **PythonSupport::sequenceItems(PyObject *py_sequence, Py_ssize_t &count)
+{
+    count = CALL_PY(PySequence_Size)(py_sequence);
+    return PySequence_Fast_ITEMS(py_sequence);
+}
+
+PyObject *PythonSupport::newReference(PyObject *py_object)
+{
+    Py_INCREF(py_object);
+    return py_object;
+}
+
+PyObject *PythonSupport::newBool(bool value)
+{
+    return newReference(value ? CALL_PY(Py_TrueGet)() : CALL_PY(Py_FalseGet)());
+}
+
+PyObject *PythonSupport::newInt(long value)
+{
+    return CALL_PY(PyLong_FromLong)(value);
+}
+
+PyObject *PythonSupport::newLongLong(long long value)
+{
+    return CALL_PY(PyLong_FromLongLong)(value);
+}
+
+PyObject *PythonSupport::newFloat(double value)
+{
+    return CALL_PY(PyFloat_FromDouble)(value);
+}
+
+PyObject *PythonSupport::newString(const char *s, Py_ssize_t size)
+{
+    return CALL_PY(PyUnicode_FromStringAndSize)(s, size);
+}
+
+PyObject *PythonSupport::newCapsule(void *pointer)
+{
+    return CALL_PY(PyCapsule_New)(pointer, PythonSupport::qobject_capsule_name, NULL);
+}
+
+PyObject *PythonSupport::newDict()
+{
+    return CALL_PY(PyDict_New)();
+}
+
+// set the item in the dict, stealing the references to the key and value.
+void PythonSupport::dictSetItem(PyObject *py_dict, PyObject *py_key, PyObject *py_value)
+{
+    if (py_key && py_value)
+        CALL_PY(PyDict_SetItem)(py_dict, py_key, py_value);
+    Py_XDECREF(py_key);
+    Py_XDECREF(py_value);
+}
+
+PyObject *PythonSupport::newTuple(Py_ssize_t size)
+{
+    return CALL_PY(PyTuple_New)(size);
+}
+
+// set the item in a new tuple, stealing the reference to the value.
+void PythonSupport::tupleSetItem(PyObject *py_tuple, Py_ssize_t index, PyObject *py_value)
+{
+    CALL_PY(PyTuple_SetItem)(py_tuple, index, py_value);
+}
 
 PythonValueVariant PythonSupport::getAttribute(PyObjectPtr *object, const std::string &attribute)
 {
-    Python_ThreadBlock thread_block;
+    Python_ThreadBlock thread_block("get attribute");
 
     PyObject *py_object = object->get();
 
@@ -789,7 +1199,7 @@ bool PythonSupport::setAttribute(PyObjectPtr *object, const std::string &attribu
 {
     int result = 0;
 
-    Python_ThreadBlock thread_block;
+    Python_ThreadBlock thread_block("set attribute");
 
     PyObject *py_object = object->get();
 
@@ -1225,6 +1635,33 @@ void PythonSupport::shapeFromImage(PyObject *arrayImage, int &width, int &height
     }
 }
 
+void PythonSupport::wordsFromArray(PyObject *ndarray_py, unsigned int word_count, std::vector<uint32_t> &words)
+{
+    // copy up to word_count 32-bit words (all words if word_count is zero) from a contiguous array.
+    Py_buffer array;
+    if (CALL_PY(PyObject_GetBuffer)(ndarray_py, &array, PyBUF_ANY_CONTIGUOUS) >= 0)
+    {
+        size_t available_count = array.len / sizeof(uint32_t);
+        size_t count = word_count > 0 ? std::min(static_cast<size_t>(word_count), available_count) : available_count;
+        words.assign((uint32_t *)array.buf, ((uint32_t *)array.buf) + count);
+        CALL_PY(PyBuffer_Release)(&array);
+    }
+    else
+    {
+        CALL_PY(PyErr_Clear)();
+        words.clear();
+    }
+}
+
+bool PythonSupport::bufferGet(PyObject *object, Py_buffer *buffer)
+{
+    // get a read-only strided buffer with its format; the buffer must be released with bufferRelease.
+    if (CALL_PY(PyObject_GetBuffer)(object, buffer, PyBUF_RECORDS_RO) >= 0)
+        return true;
+    CALL_PY(PyErr_Clear)();
+    return false;
+}
+
 void PythonSupport::bufferRelease(Py_buffer *buffer)
 {
     CALL_PY(PyBuffer_Release)(buffer);
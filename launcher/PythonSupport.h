@@ -29,33 +29,73 @@
 #define PyCodeObject PyObject
 
 // Use this when calling back to Python code to grab the GIL and release it when the
-// Python code returns.
+// Python code returns. The tag identifies the call site in the GIL statistics and must
+// be a string literal.
 struct Python_ThreadBlockState;
 class Python_ThreadBlock
 {
 public:
-    Python_ThreadBlock() : m_state(NULL) { grab(); }
+    Python_ThreadBlock(const char *tag = "block") : m_tag(tag), m_state(NULL) { grab(); }
     ~Python_ThreadBlock() { release(); }
     void release();
     void grab();
 private:
+    const char *m_tag;
     Python_ThreadBlockState *m_state;
 };
 
 // Use this when being called from Python to save the current thread, release the GIL,
 // and then grab the GIL and restore the current thread when returning to Python.
+// The tag identifies the call site in the GIL statistics and must be a string literal.
 struct Python_ThreadAllowState;
 class Python_ThreadAllow
 {
 public:
-    Python_ThreadAllow() : m_state(NULL) { grab(); }
+    Python_ThreadAllow(const char *tag = "allow") : m_tag(tag), m_state(NULL) { grab(); }
     ~Python_ThreadAllow() { release(); }
     void release();
     void grab();
 private:
+    const char *m_tag;
     Python_ThreadAllowState *m_state;
 };
 
+/*
+ GIL statistics per call site tag, recorded only while enabled.
+
+ The wait is the time spent acquiring the GIL. The hold is the time the GIL is held: for Python_ThreadBlock, until the
+ block is released; for Python_ThreadAllow, since the thread last acquired the GIL through a guard. Bucket i counts
+ durations below 2^i microseconds; the last bucket also counts longer durations.
+ */
+const int GIL_HISTOGRAM_BUCKET_COUNT = 32;
+
+struct GILDurationHistogram
+{
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::vector<uint64_t> buckets;
+};
+
+struct GILCallSiteStatistics
+{
+    GILDurationHistogram wait;
+    GILDurationHistogram hold;
+};
+
+void SetGILInstrumentationEnabled(bool enabled);
+bool IsGILInstrumentationEnabled();
+void GetGILStatistics(std::map<std::string, GILCallSiteStatistics> &statistics, bool reset);
+
+// release a reference, deferring the release if the calling thread does not hold the GIL.
+void ReleasePyObject(PyObject *py_object);
+
+// release a buffer acquired with bufferGet, deferring the release if the calling thread does not hold the GIL.
+void ReleasePyBuffer(const Py_buffer &py_buffer);
+
+// release the references and buffers deferred by ReleasePyObject and ReleasePyBuffer. the GIL must be held.
+void ReleaseDeferredPyObjects();
+
 class PyObjectPtr
 {
 public:
@@ -69,16 +109,31 @@ public:
     }
     PyObjectPtr(const PyObjectPtr &py_object_ptr)
     {
-        Python_ThreadBlock thread_block;
         py_object = py_object_ptr.get();
-        Py_INCREF(py_object);
+        if (py_object)
+        {
+            Python_ThreadBlock thread_block;
+            Py_INCREF(py_object);
+        }
     }
+    PyObjectPtr(PyObjectPtr &&py_object_ptr) noexcept : py_object(py_object_ptr.release()) { }
     ~PyObjectPtr()
     {
-        Python_ThreadBlock thread_block;
-        Py_XDECREF(this->py_object);
+        // destruction does not wait for the GIL; see ReleasePyObject.
+        if (py_object)
+            ReleasePyObject(py_object);
     }
     PyObjectPtr &operator=(const PyObjectPtr &) = delete;
+    PyObjectPtr &operator=(PyObjectPtr &&py_object_ptr) noexcept
+    {
+        if (this != &py_object_ptr)
+        {
+            if (py_object)
+                ReleasePyObject(py_object);
+            py_object = py_object_ptr.release();
+        }
+        return *this;
+    }
     PyObject *get() const { return this->py_object; }
     PyObject *release()
     {
@@ -162,10 +217,35 @@ public:
     void scaledImageFromArray(PyObject *ndarray_py, float width, float height, float context_scaling, float display_limit_low, float display_limit_high, PyObject *lookup_table, ImageInterface *image);
     void arrayFromImage(const ImageInterface &image, PyObject *target);
     void shapeFromImage(PyObject *image, int &width, int &height);
+    void wordsFromArray(PyObject *ndarray_py, unsigned int word_count, std::vector<uint32_t> &words);
+    bool bufferGet(PyObject *object, Py_buffer *buffer);
     void bufferRelease(Py_buffer *buffer);
     PythonValueVariant invokePyMethod(PyObjectPtr *object, const std::string &method, const std::list<PythonValueVariant> &args);
     bool setAttribute(PyObjectPtr *object, const std::string &attribute, const PythonValueVariant &value);
     PythonValueVariant getAttribute(PyObjectPtr *object, const std::string &attribute);
+    PyObject *callPyMethod(PyObjectPtr *object, const std::string &method, PyObject *py_args);
+    PyObject *dispatchPyMethod(PyObject *py_object, const std::string &method, std::vector<PyObject *> &py_args);
+
+    // value access and construction for converters that bypass PythonValueVariant. the GIL must be held.
+    enum ValueKind { ValueNone, ValueString, ValueInt, ValueFloat, ValueCapsule, ValueDict, ValueSequence, ValueOther };
+    ValueKind valueKind(PyObject *py_object);
+    const char *stringValue(PyObject *py_object, Py_ssize_t &size);
+    long intValue(PyObject *py_object);
+    double floatValue(PyObject *py_object);
+    void *capsuleValue(PyObject *py_object);
+    bool dictNext(PyObject *py_dict, Py_ssize_t &pos, PyObject *&py_key, PyObject *&py_value);
+    PyObject **sequenceItems(PyObject *py_sequence, Py_ssize_t &count);
+    PyObject *newReference(PyObject *py_object);
+    PyObject *newBool(bool value);
+    PyObject *newInt(long value);
+    PyObject *newLongLong(long long value);
+    PyObject *newFloat(double value);
+    PyObject *newString(const char *s, Py_ssize_t size);
+    PyObject *newCapsule(void *pointer);
+    PyObject *newDict();
+    void dictSetItem(PyObject *py_dict, PyObject *py_key, PyObject *py_value);
+    PyObject *newTuple(Py_ssize_t size);
+    void tupleSetItem(PyObject *py_tuple, Py_ssize_t index, PyObject *py_value);
     void setErrorString(const std::string &error_string);
     PyObject *getPyListFromStrings(const std::vector<std::string> &strings);
     PyArg_ParseTupleFn parse();
@@ -209,6 +289,12 @@ private:
 
     // exceptions
     PyObject *module_exception;
+
+    // interned method names for dispatchPyMethod, held until Python is finalized.
+    std::map<std::string, PyObject *> m_method_names;
+
+    PyObject *methodName(const std::string &method);
+    void clearMethodNames();
 };
 
 #endif // PYTHON_SUPPORT_H
@@ -3,6 +3,7 @@ import importlib.util
 import os
 import site
 import sys
+import traceback
 import HostLib  # host supplies this module
 
 
@@ -25,6 +26,15 @@ def bootstrap_dispatch(object, method_name, args):
     return getattr(object, method_name)(*args)
 
 
+def bootstrap_dispatch_batch(records):
+    # an exception in one handler must not prevent delivery of the remaining events.
+    for object, method_name, args in records:
+        try:
+            getattr(object, method_name)(*args)
+        except Exception:
+            traceback.print_exc()
+
+
 class HostLibProxy:
 
     def __init__(self, nion_lib):
@@ -0,0 +1,35 @@
+# run the native tests of the launcher; print ACK and exit if they pass.
+
+class Delegate:
+    """Record the methods dispatched by the native tests and answer the item model queries."""
+
+    results = {"itemCount": 7, "itemId": 100, "itemParent": [-1, 0], "itemValue": "python"}
+
+    def __init__(self):
+        self.events = list()
+
+    def takeEvents(self):
+        events, self.events = self.events, list()
+        return events
+
+    def __getattr__(self, name):
+        def record(*args):
+            self.events.append([name, list(args)])
+            return Delegate.results.get(name)
+        return record
+
+
+class Application:
+    def __init__(self, proxy):
+        self.__proxy = proxy
+
+    def start(self):
+        failures = self.__proxy.Core_runNativeTests(Delegate())
+        for failure in failures:
+            print(failure)
+        if not failures:
+            print("ACK")
+        return False
+
+def main(args, bootstrap_args):
+    return Application(bootstrap_args["proxy"])